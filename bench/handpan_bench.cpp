@@ -0,0 +1,451 @@
+// Host-side offline render + benchmark for the Handpan plugins
+// Author: Fabian Martinez
+//
+// Compiles one of the plugin sources for the host (x86/ARM Linux, macOS) and
+// drives construct() and step() with scripted gate / 1V/oct buffers, so CPU
+// changes can be measured without flashing the module.
+//
+// Build (from the repository root, NT_API = path to the disting NT API "include" folder):
+//
+//   g++ -O2 -std=c++17 -I$NT_API bench/handpan_bench.cpp -o handpan_bench
+//   g++ -O2 -std=c++17 -I$NT_API -DHANDPAN_SOURCE='"../handpan_extNT.cpp"' bench/handpan_bench.cpp -o handpan_bench_nt
+//
+// Usage:
+//
+//   ./handpan_bench [--seconds 12] [--block 32] [--spec index=value ...] [--param index=value ...] [--midi] [--wav out.wav]
+//   ./handpan_bench --accuracy
+//   ./handpan_bench --check
+//
+// Prints ns per sample and the real-time factor (audio time / compute time)
+// for every active voice count seen during the render, plus a checksum of the
+// output so that renders can be compared between builds.
+//
+// --midi plays the same script as MIDI notes (channels 1 and 2, varying
+// velocity, note-off after 300 ms) instead of gates and 1V/oct.
+//
+// --accuracy sweeps the handpan_fastmath.h functions against libm, prints the
+// worst error of each and fails (exit code 1) if a documented bound is broken.
+//
+// --check renders short scripted cases and fails (exit code 1) if one goes
+// wrong: stolen voices must fade out, also when several steals overlap, and
+// every resonator type must stay finite and bounded on every engine.
+
+#ifndef HANDPAN_SOURCE
+#define HANDPAN_SOURCE "../handpan_ext.cpp"
+#endif
+
+#include HANDPAN_SOURCE
+
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+
+#ifndef BENCH_SAMPLE_RATE
+#define BENCH_SAMPLE_RATE 48000
+#endif
+
+#define BENCH_NUM_BUSSES 28
+#define BENCH_MAX_BLOCK 512
+
+// Shared scratch size; build with a small value to exercise the plugin's own fallback scratch
+#ifndef BENCH_WORK_BUFFER_FLOATS
+#define BENCH_WORK_BUFFER_FLOATS (BENCH_MAX_BLOCK * 8)
+#endif
+
+// --- Host stand-ins for what the module firmware provides ---
+static float benchWorkBuffer[BENCH_WORK_BUFFER_FLOATS];
+
+const _NT_globals NT_globals = {
+    .sampleRate = BENCH_SAMPLE_RATE,
+    .maxFramesPerStep = BENCH_MAX_BLOCK,
+    .workBuffer = benchWorkBuffer,
+    .workBufferSizeBytes = sizeof(benchWorkBuffer),
+};
+
+extern "C" void NT_drawText(int, int, const char*, int, _NT_textAlignment, _NT_textSize) {}
+extern "C" void NT_drawShapeI(_NT_shape, int, int, int, int, int) {}
+
+// Number of voices currently sounding (used to bin the timings)
+static int benchActiveVoices(_NT_algorithm* base) {
+    ModalInstrument* self = static_cast<ModalInstrument*>(base);
+    int n = 0;
+    for (int v = 0; v < self->numVoices; ++v)
+        if (self->voices[v].active) n++;
+    return n;
+}
+
+// Scripted performance: both hands roll through a handpan scale, the tempo
+// doubles every phase so every polyphony level gets visited.
+struct BenchScript {
+    static constexpr int kNumPhases = 6;
+    float phaseSeconds;
+
+    float rateHz(float t) const {
+        int phase = (int)(t / phaseSeconds);
+        if (phase >= kNumPhases) phase = kNumPhases - 1;
+        return 0.5f * (float)(1 << phase);    // 0.5, 1, 2, 4, 8, 16 hits per second per hand
+    }
+};
+
+static const float benchScale[] = { 0.0f, 3.0f, 5.0f, 7.0f, 8.0f, 10.0f, 12.0f, 15.0f }; // semitones (D Kurd-ish)
+
+// --- Fast math accuracy sweep ---
+struct AccuracyCase {
+    const char* name;
+    float (*fast)(float);
+    double (*reference)(double);
+    float lo, hi;
+    int errorKind;          // 0 = absolute, 1 = relative, 2 = absolute / max(1, |reference|)
+    double bound;
+};
+
+static float benchFastPow09985(float k) { return fastPow(0.9985f, k); }
+static double benchPow09985(double k) { return pow((double)0.9985f, k); }
+static double benchExp2(double x) { return exp2(x); }
+static double benchExp(double x) { return exp(x); }
+static double benchLog2(double x) { return log2(x); }
+static double benchLog(double x) { return log(x); }
+static double benchTanh(double x) { return tanh(x); }
+static double benchSin(double x) { return sin(x); }
+static double benchCos(double x) { return cos(x); }
+
+static int runAccuracy() {
+    const AccuracyCase cases[] = {
+        { "fastExp2", fastExp2, benchExp2, -126.0f, 126.0f, 1, 3.0e-7 },
+        { "fastExp", fastExp, benchExp, -87.0f, 87.0f, 1, 4.0e-6 },
+        { "fastExp (decay)", fastExp, benchExp, -4.0f, 4.0f, 1, 5.0e-7 },
+        { "fastLog2", fastLog2, benchLog2, 1.2e-38f, 3.0e38f, 2, 2.0e-7 },
+        { "fastLog", fastLog, benchLog, 1.2e-38f, 3.0e38f, 2, 2.0e-7 },
+        { "fastPow(0.9985,k)", benchFastPow09985, benchPow09985, 0.0f, 8.0f, 1, 2.0e-6 },
+        { "fastTanh", fastTanh, benchTanh, -20.0f, 20.0f, 0, 3.0e-7 },
+        { "fastSin", fastSin, benchSin, -1000.0f, 1000.0f, 0, 3.0e-7 },
+        { "fastCos", fastCos, benchCos, -1000.0f, 1000.0f, 0, 3.0e-7 },
+    };
+    const int steps = 1 << 22;
+    int failures = 0;
+    printf("%-18s %12s %12s %12s\n", "function", "worst error", "at x", "bound");
+    for (const AccuracyCase& c : cases) {
+        bool logSweep = (c.lo > 0.0f && c.hi / c.lo > 1e6f);   // log functions: sweep the exponent range too
+        double worst = 0.0, worstX = c.lo;
+        for (int i = 0; i <= steps; ++i) {
+            double t = (double)i / steps;
+            float x = logSweep ? (float)(c.lo * pow((double)c.hi / c.lo, t)) : (float)(c.lo + (c.hi - c.lo) * t);
+            double ref = c.reference((double)x);
+            double err = fabs((double)c.fast(x) - ref);
+            if (c.errorKind == 1 && ref != 0.0) err /= fabs(ref);
+            if (c.errorKind == 2 && fabs(ref) > 1.0) err /= fabs(ref);
+            if (err > worst) { worst = err; worstX = x; }
+        }
+        bool ok = (worst <= c.bound);
+        printf("%-18s %12.3g %12.6g %12.3g %s\n", c.name, worst, worstX, c.bound, ok ? "" : "FAIL");
+        if (!ok) failures++;
+    }
+    return failures ? 1 : 0;
+}
+
+static void writeWav(const char* path, const std::vector<float>& interleaved, int sampleRate) {
+    FILE* f = fopen(path, "wb");
+    if (!f) { fprintf(stderr, "cannot write %s\n", path); return; }
+    uint32_t dataBytes = (uint32_t)(interleaved.size() * sizeof(float));
+    uint32_t riffSize = 36 + dataBytes;
+    uint16_t format = 3, channels = 2, bits = 32, blockAlign = channels * bits / 8;
+    uint32_t rate = sampleRate, byteRate = rate * blockAlign, fmtSize = 16;
+    fwrite("RIFF", 1, 4, f); fwrite(&riffSize, 4, 1, f); fwrite("WAVE", 1, 4, f);
+    fwrite("fmt ", 1, 4, f); fwrite(&fmtSize, 4, 1, f); fwrite(&format, 2, 1, f);
+    fwrite(&channels, 2, 1, f); fwrite(&rate, 4, 1, f); fwrite(&byteRate, 4, 1, f);
+    fwrite(&blockAlign, 2, 1, f); fwrite(&bits, 2, 1, f);
+    fwrite("data", 1, 4, f); fwrite(&dataBytes, 4, 1, f);
+    fwrite(interleaved.data(), sizeof(float), interleaved.size(), f);
+    fclose(f);
+}
+
+// One plugin instance, created the way the firmware does it: static memory
+// once per run, then requirements, memory, construct and every parameter
+struct BenchInstance {
+    const _NT_factory* fac;
+    _NT_algorithm* alg;
+    _NT_algorithmMemoryPtrs ptrs;
+    std::vector<int16_t> v;
+
+    BenchInstance(const std::vector<std::pair<int, int>>& specOverrides, const std::vector<std::pair<int, int>>& overrides) {
+        fac = (const _NT_factory*)pluginEntry(kNT_selector_factoryInfo, 0);
+
+        std::vector<int32_t> specs(fac->numSpecifications);
+        for (uint32_t s = 0; s < fac->numSpecifications; ++s) specs[s] = fac->specifications[s].def;
+        for (auto& o : specOverrides)
+            if (o.first >= 0 && o.first < (int)specs.size()) specs[o.first] = o.second;
+
+        static bool staticReady = false;
+        if (fac->calculateStaticRequirements && !staticReady) {
+            static _NT_staticRequirements staticReq;
+            static _NT_staticMemoryPtrs staticPtrs;
+            fac->calculateStaticRequirements(staticReq);
+            staticPtrs.dram = (uint8_t*)aligned_alloc(64, (staticReq.dram + 63) & ~63u);
+            if (fac->initialise) fac->initialise(staticPtrs, staticReq);
+            staticReady = true;
+        }
+
+        _NT_algorithmRequirements req;
+        memset(&req, 0, sizeof(req));
+        fac->calculateRequirements(req, specs.data());
+
+        ptrs.sram = (uint8_t*)aligned_alloc(64, (req.sram + 63) & ~63u);
+        ptrs.dram = req.dram ? (uint8_t*)aligned_alloc(64, (req.dram + 63) & ~63u) : nullptr;
+        ptrs.dtc  = req.dtc  ? (uint8_t*)aligned_alloc(64, (req.dtc  + 63) & ~63u) : nullptr;
+        ptrs.itc  = req.itc  ? (uint8_t*)aligned_alloc(64, (req.itc  + 63) & ~63u) : nullptr;
+
+        alg = fac->construct(ptrs, req, specs.data());
+
+        v.resize(req.numParameters);
+        for (uint32_t p = 0; p < req.numParameters; ++p) v[p] = alg->parameters[p].def;
+        for (auto& o : overrides)
+            if (o.first >= 0 && o.first < (int)req.numParameters) v[o.first] = (int16_t)o.second;
+        alg->v = v.data();
+        alg->vIncludingCommon = v.data();
+        for (uint32_t p = 0; p < req.numParameters; ++p)
+            if (fac->parameterChanged) fac->parameterChanged(alg, p);
+    }
+
+    ~BenchInstance() {
+        free(ptrs.sram);
+        free(ptrs.dram);
+        free(ptrs.dtc);
+        free(ptrs.itc);
+    }
+};
+
+// --- Voice stealing check ---
+// Both lanes strike, then two more notes a few samples apart steal both
+// voices of a 2-voice instance, the second while the first stolen tail is
+// still fading. Against a render with enough voices for every note to ring,
+// the difference is the stolen tails: it must fade in, not jump. A fade only
+// bends the difference, a cut steps it, which shows in the second difference.
+static std::vector<float> benchRenderSteals(int voices, int secondSteal) {
+    BenchInstance instance({ { kSpecVoices, voices } }, {});
+    const int block = 32, totalFrames = 9600;
+    const int hits[4][2] = { { 0, 0 }, { 1, 200 }, { 0, 4800 }, { 1, 4800 + secondSteal } };   // lane, frame
+    const float pitch[2] = { 0.0f, 7.0f / 12.0f };
+    const int gateFrames = 240;
+    std::vector<float> bus(BENCH_NUM_BUSSES * block), out;
+    for (int frame = 0; frame < totalFrames; frame += block) {
+        memset(bus.data(), 0, sizeof(float) * bus.size());
+        for (int f = 0; f < block; ++f) {
+            for (const auto& hit : hits) {
+                int t = frame + f - hit[1];
+                if (t >= 0 && t < gateFrames) bus[hit[0] * block + f] = 5.0f;
+            }
+            bus[2 * block + f] = pitch[0];
+            bus[3 * block + f] = pitch[1];
+        }
+        instance.fac->step(instance.alg, bus.data(), block / 4);
+        const float* outL = &bus[(instance.v[kParamOutputL] - 1) * block];
+        out.insert(out.end(), outL, outL + block);
+    }
+    return out;
+}
+
+static float benchStealStep(int secondSteal) {
+    std::vector<float> stolen = benchRenderSteals(2, secondSteal);
+    std::vector<float> ringing = benchRenderSteals(8, secondSteal);
+    float worst = 0.0f;
+    for (size_t f = 4802; f < stolen.size(); ++f) {
+        float d0 = ringing[f] - stolen[f];
+        float d1 = ringing[f - 1] - stolen[f - 1];
+        float d2 = ringing[f - 2] - stolen[f - 2];
+        worst = fmaxf(worst, fabsf(d0 - 2.0f * d1 + d2));
+    }
+    return worst;
+}
+
+#define BENCH_STEAL_STEP_BOUND 0.03f    // A cut tail steps by about 0.1 here, a faded one bends by about 0.012
+
+// --- Resonator stability check ---
+// Every resonator type on every engine: both lanes strike notes from low to
+// high for two seconds. Returns the loudest output sample, or infinity as
+// soon as one sample is not finite (a mode blew up).
+static float benchRenderTypePeak(int resType, int engine) {
+    BenchInstance instance({}, { { kParamResonatorType, resType }, { kParamEngine, engine } });
+    const int block = 32, totalFrames = 96000, hitFrames = 6000, gateFrames = 240;
+    const float pitch[4] = { -1.0f, 0.0f, 1.0f, 2.0f };     // 1V/oct around the root
+    std::vector<float> bus(BENCH_NUM_BUSSES * block);
+    float peak = 0.0f;
+    for (int frame = 0; frame < totalFrames; frame += block) {
+        memset(bus.data(), 0, sizeof(float) * bus.size());
+        for (int f = 0; f < block; ++f) {
+            int hit = (frame + f) / hitFrames;
+            int lane = hit & 1;
+            if ((frame + f) % hitFrames < gateFrames) bus[lane * block + f] = 5.0f;
+            bus[2 * block + f] = pitch[(hit & ~1) / 2 % 4];
+            bus[3 * block + f] = pitch[(hit | 1) / 2 % 4] + 7.0f / 12.0f;
+        }
+        instance.fac->step(instance.alg, bus.data(), block / 4);
+        const int outputs[2] = { kParamOutputL, kParamOutputR };
+        for (int c = 0; c < 2; ++c) {
+            const float* out = &bus[(instance.v[outputs[c]] - 1) * block];
+            for (int f = 0; f < block; ++f) {
+                if (!std::isfinite(out[f])) return INFINITY;
+                peak = fmaxf(peak, fabsf(out[f]));
+            }
+        }
+    }
+    return peak;
+}
+
+#define BENCH_TYPE_PEAK_BOUND 100.0f    // Stable types peak below 30 here
+
+static int runChecks() {
+    int failures = 0;
+    const int gaps[] = { 4000, 40, 8 };             // Second steal after the first one, in samples
+    printf("%-28s %12s %12s\n", "check", "worst", "bound");
+    for (int gap : gaps) {
+        float step = benchStealStep(gap);
+        bool ok = (step <= BENCH_STEAL_STEP_BOUND);
+        char name[64];
+        snprintf(name, sizeof(name), "steals %d samples apart", gap);
+        printf("%-28s %12.3g %12.3g %s\n", name, step, BENCH_STEAL_STEP_BOUND, ok ? "" : "FAIL");
+        if (!ok) failures++;
+    }
+    for (int engine = 0; engine < (int)ARRAY_SIZE(engineModes); ++engine) {
+        for (int type = 0; type < (int)ARRAY_SIZE(resonatorTypes); ++type) {
+            float peak = benchRenderTypePeak(type, engine);
+            bool ok = (peak <= BENCH_TYPE_PEAK_BOUND);     // Also false for a non-finite output
+            char name[64];
+            snprintf(name, sizeof(name), "%s, %s", engineModes[engine], resonatorTypes[type]);
+            printf("%-28s %12.3g %12.3g %s\n", name, peak, BENCH_TYPE_PEAK_BOUND, ok ? "" : "FAIL");
+            if (!ok) failures++;
+        }
+    }
+    return failures ? 1 : 0;
+}
+
+int main(int argc, char** argv) {
+    float seconds = 12.0f;
+    int block = 32;
+    const char* wavPath = nullptr;
+    bool midi = false;
+    std::vector<std::pair<int, int>> overrides;
+    std::vector<std::pair<int, int>> specOverrides;
+
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--accuracy")) return runAccuracy();
+        else if (!strcmp(argv[i], "--check")) return runChecks();
+        else if (!strcmp(argv[i], "--seconds") && i + 1 < argc) seconds = (float)atof(argv[++i]);
+        else if (!strcmp(argv[i], "--block") && i + 1 < argc) block = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--wav") && i + 1 < argc) wavPath = argv[++i];
+        else if (!strcmp(argv[i], "--midi")) midi = true;
+        else if (!strcmp(argv[i], "--param") && i + 1 < argc) {
+            int index = 0, value = 0;
+            if (sscanf(argv[++i], "%d=%d", &index, &value) == 2) overrides.push_back({ index, value });
+        } else if (!strcmp(argv[i], "--spec") && i + 1 < argc) {
+            int index = 0, value = 0;
+            if (sscanf(argv[++i], "%d=%d", &index, &value) == 2) specOverrides.push_back({ index, value });
+        } else {
+            fprintf(stderr, "usage: %s [--seconds s] [--block frames] [--spec index=value] [--param index=value] [--midi] [--wav file] | --accuracy | --check\n", argv[0]);
+            return 1;
+        }
+    }
+    block = (block < 4 ? 4 : (block > BENCH_MAX_BLOCK ? BENCH_MAX_BLOCK : block)) & ~3;
+
+    // --- Plugin lifecycle, as the firmware does it ---
+    BenchInstance instance(specOverrides, overrides);
+    const _NT_factory* fac = instance.fac;
+    _NT_algorithm* alg = instance.alg;
+    const std::vector<int16_t>& v = instance.v;
+
+    // --- Render ---
+    const int sampleRate = BENCH_SAMPLE_RATE;
+    const long totalFrames = (long)(seconds * sampleRate);
+    BenchScript script = { seconds / BenchScript::kNumPhases };
+
+    std::vector<float> bus(BENCH_NUM_BUSSES * block);
+    std::vector<float> rendered;
+    if (wavPath) rendered.reserve(totalFrames * 2);
+
+    const int maxVoices = 64;
+    double binNs[maxVoices + 1] = {};
+    long binFrames[maxVoices + 1] = {};
+    long binBlocks[maxVoices + 1] = {};
+
+    uint64_t checksum = 1469598103934665603ull;     // FNV-1a over the output bytes
+    float nextHit[2] = { 0.0f, 0.25f };             // seconds; hand 2 is offset
+    float lastHit[2] = { -1.0f, -1.0f };
+    int noteIndex[2] = { 0, 4 };
+    float heldNote[2] = { 0.0f, 0.0f };
+    const float gateSeconds = 0.005f;
+    const float midiNoteSeconds = 0.3f;
+    int midiNote[2] = { -1, -1 };
+    int hits = 0;
+
+    for (long frame = 0; frame < totalFrames; frame += block) {
+        int n = block;
+        if (frame + n > totalFrames) n = (int)(totalFrames - frame) & ~3;
+        if (n <= 0) break;
+
+        // Inputs: busses 1/2 gates, 3/4 note CV (the factory defaults)
+        float* gate[2] = { &bus[0 * n], &bus[1 * n] };
+        float* note[2] = { &bus[2 * n], &bus[3 * n] };
+        memset(bus.data(), 0, sizeof(float) * BENCH_NUM_BUSSES * n);
+        for (int f = 0; f < n; ++f) {
+            float t = (frame + f) / (float)sampleRate;
+            for (int h = 0; h < 2; ++h) {
+                if (midi && midiNote[h] >= 0 && t - lastHit[h] >= midiNoteSeconds) {
+                    fac->midiMessage(alg, 0x80 | h, midiNote[h], 64);
+                    midiNote[h] = -1;
+                }
+                if (t >= nextHit[h]) {
+                    heldNote[h] = benchScale[noteIndex[h]] / 12.0f;
+                    if (midi) {
+                        if (midiNote[h] >= 0) fac->midiMessage(alg, 0x80 | h, midiNote[h], 64);
+                        midiNote[h] = 60 + (int)benchScale[noteIndex[h]];
+                        fac->midiMessage(alg, 0x90 | h, midiNote[h], 40 + (hits++ * 37) % 88);
+                    }
+                    noteIndex[h] = (noteIndex[h] + 3) % (int)ARRAY_SIZE(benchScale);
+                    lastHit[h] = t;
+                    nextHit[h] += 1.0f / script.rateHz(t);
+                }
+                gate[h][f] = (!midi && t - lastHit[h] < gateSeconds) ? 5.0f : 0.0f;
+                note[h][f] = heldNote[h];
+            }
+        }
+
+        auto t0 = std::chrono::steady_clock::now();
+        fac->step(alg, bus.data(), n / 4);
+        auto t1 = std::chrono::steady_clock::now();
+
+        int voices = benchActiveVoices(alg);
+        if (voices > maxVoices) voices = maxVoices;
+        binNs[voices] += std::chrono::duration<double, std::nano>(t1 - t0).count();
+        binFrames[voices] += n;
+        binBlocks[voices]++;
+
+        const float* outL = &bus[(v[kParamOutputL] - 1) * n];
+        const float* outR = &bus[(v[kParamOutputR] - 1) * n];
+        for (int f = 0; f < n; ++f) {
+            const unsigned char* bytes[2] = { (const unsigned char*)&outL[f], (const unsigned char*)&outR[f] };
+            for (int c = 0; c < 2; ++c)
+                for (int b = 0; b < 4; ++b) { checksum ^= bytes[c][b]; checksum *= 1099511628211ull; }
+            if (wavPath) { rendered.push_back(outL[f]); rendered.push_back(outR[f]); }
+        }
+    }
+
+    // --- Report ---
+    printf("%s: %d Hz, %d-frame blocks, %ld frames\n", fac->name, sampleRate, block, totalFrames);
+    printf("%6s %8s %12s %10s\n", "voices", "blocks", "ns/sample", "RTF");
+    double totalNs = 0.0;
+    long totalRendered = 0;
+    for (int i = 0; i <= maxVoices; ++i) {
+        if (!binBlocks[i]) continue;
+        double nsPerSample = binNs[i] / binFrames[i];
+        printf("%6d %8ld %12.1f %10.1f\n", i, binBlocks[i], nsPerSample, 1e9 / (nsPerSample * sampleRate));
+        totalNs += binNs[i];
+        totalRendered += binFrames[i];
+    }
+    if (totalRendered) {
+        double nsPerSample = totalNs / totalRendered;
+        printf("%6s %8s %12.1f %10.1f\n", "all", "", nsPerSample, 1e9 / (nsPerSample * sampleRate));
+    }
+    printf("checksum %016llx\n", (unsigned long long)checksum);
+
+    if (wavPath) writeWav(wavPath, rendered, sampleRate);
+    return 0;
+}
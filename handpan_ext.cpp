@@ -84,194 +84,727 @@ SOFTWARE.
 #include <cstring>
 #include <new>
 #include <cstdio>
-
-#ifndef M_PI
-#define M_PI 3.14159265358979323846f
+#include <atomic>
+#include "handpan_fastmath.h"
+
+// Module build (bare-metal Cortex-M7) or computer build (bench, any OS,
+// including ARM Linux). Can be forced with -DHANDPAN_DEVICE_BUILD=0/1.
+#ifndef HANDPAN_DEVICE_BUILD
+#if defined(__arm__) && !defined(__linux__) && !defined(__APPLE__)
+#define HANDPAN_DEVICE_BUILD 1
+#else
+#define HANDPAN_DEVICE_BUILD 0
+#endif
 #endif
 
-#ifndef EXCITATION_BUFFER_SIZE
-#define EXCITATION_BUFFER_SIZE 2048
+#if !HANDPAN_DEVICE_BUILD
+#include <chrono>                   // CPU governor clock in computer builds
 #endif
 
-#ifndef EXCITATION_NOISETABLE_SIZE
-#define EXCITATION_NOISETABLE_SIZE 2048
+#ifndef M_PI
+#define M_PI 3.14159265358979323846f
 #endif
 
-#define NUM_VOICES 8
+// Polyphony and modes per voice are specifications, chosen when the algorithm is added
+#define MIN_VOICES 2
+#define MAX_VOICES 32
+#define DEFAULT_VOICES 8
 #define MAX_MODES 16
+#define DEFAULT_MODES 8
+#define MAX_LANES 8             // Gate / pitch input pairs (Lanes specification)
+#define DEFAULT_LANES 2
 #define SAMPLE_RATE NT_globals.sampleRate
 
-// NOISE
-static uint32_t noiseSeed = 1;
-inline float fastWhiteNoise() {
-    noiseSeed = 1664525 * noiseSeed + 1013904223;
-    return ((noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
-}
+// Fast seedable PRNG (xorshift32). Every instance owns one, so renders are
+// reproducible and instances never disturb each other.
+struct Rng {
+    uint32_t state = 0x2545F491u;
+
+    void seed(uint32_t s) { state = s ? s : 0x2545F491u; }
+
+    uint32_t next() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    // Uniform in [-1, 1)
+    float bipolar() { return (int32_t)next() * (1.0f / 2147483648.0f); }
+};
 
 // Utility function to get CV or parameter value
 inline float getCVOrParam(float* cv, int f, float paramValue, float scale = 1.0f, float threshold = 0.001f) {
     return (cv && fabsf(cv[f]) > threshold) ? (cv[f] * scale) : paramValue;
 }
 
-// Noise table for excitation (not used for per-sample noise)
-float noiseTable[EXCITATION_NOISETABLE_SIZE];
-bool noiseInit = false;
-
 // Soft clipping function to avoid harsh digital clipping
 inline float softclip(float x) {
-    return tanhf(x);
+    return fastTanh(x);
 }
 
+// Control-rate parameter: the target is sampled once per block and reached
+// with a linear ramp over the block, so parameter moves don't step the audio
+struct ControlRamp {
+    float value = 0.0f;
+    float inc = 0.0f;
+    bool primed = false;
+
+    void setTarget(float target, int numFrames) {
+        if (!primed || fabsf(target - value) < 1e-6f) { value = target; primed = true; }
+        inc = (target - value) / numFrames;
+    }
+
+    float next() { value += inc; return value; }
+};
+
 //--------------------------------------------------------------
-// ModalResonator: represents a single resonant mode
+// Coefficient tables: trigger-time resonator maths without libm calls
 //--------------------------------------------------------------
-struct ModalResonator {
-    float freq = 0.0f;          // Resonance frequency (Hz)
-    float gain = 1.0f;          // Resonator gain
-    float bandwidth = 0.1f;     // Bandwidth (Hz)
-    float env = 1.0f;           // Envelope (for exponential decay)
-    float age = 0.0f;           // Age in seconds since trigger
-    float y1 = 0.0f, y2 = 0.0f; // Previous outputs (for difference equation)
-    float a1 = 0.0f, a2 = 0.0f; // Filter coefficients
-    float r = 0.0f;             // Pole radius (for coefficient calculation)
-    
-
-    // Initialize the resonator (call on trigger)
-    void init(float f, float g, float bw, int type = 0) {
-        gain = g;
-        if (type == 3) bw *= 1.5f; // For "damped" type, increase bandwidth
-        bandwidth = fmaxf(bw, 0.05f);
-        env = 1.0f;
+// Built once when the plugin is loaded (static memory, shared by all
+// instances, read-only afterwards). The table gives the coarse value and the
+// remainder is applied with the angle-sum / product identity and a short
+// Taylor series (truncation below 1e-9), so the result is within a few float
+// ulps of libm. Plain linear interpolation is not enough for
+// a1 = -2 r cos(w): at 40Hz a cos error of 1e-6 already detunes the mode by
+// several percent.
+#define COS_TABLE_SIZE 256      // Steps over [0, pi]
+#define EXP_TABLE_STEPS 64      // Steps per unit of x for exp(-x)
+#define EXP_TABLE_RANGE 16      // exp(-x) is treated as 0 beyond x = 16
+
+struct CoefTables {
+    float cosTable[COS_TABLE_SIZE + 1];                     // cos(pi * i / N)
+    float sinTable[COS_TABLE_SIZE + 1];                     // sin(pi * i / N)
+    float expTable[EXP_TABLE_STEPS * EXP_TABLE_RANGE + 1];  // exp(-i / steps)
+
+    void build() {
+        for (int i = 0; i <= COS_TABLE_SIZE; ++i) {
+            cosTable[i] = cosf(M_PI * i / COS_TABLE_SIZE);
+            sinTable[i] = sinf(M_PI * i / COS_TABLE_SIZE);
+        }
+        for (int i = 0; i <= EXP_TABLE_STEPS * EXP_TABLE_RANGE; ++i)
+            expTable[i] = expf(-(float)i / EXP_TABLE_STEPS);
+    }
+
+    // cos(w) for w in [0, pi]
+    float cos(float w) const {
+        if (w <= 0.0f) return 1.0f;
+        if (w >= M_PI) return -1.0f;
+        float x = w * (COS_TABLE_SIZE / M_PI);
+        int i = (int)x;
+        float b = (x - i) * (M_PI / COS_TABLE_SIZE);
+        float b2 = b * b;
+        return cosTable[i] * (1.0f - 0.5f * b2) - sinTable[i] * b * (1.0f - b2 * (1.0f / 6.0f));
+    }
+
+    // exp(-x) for x >= 0
+    float expNeg(float x) const {
+        if (x <= 0.0f) return 1.0f;
+        float t = x * EXP_TABLE_STEPS;
+        if (t >= EXP_TABLE_STEPS * EXP_TABLE_RANGE) return 0.0f;
+        int i = (int)t;
+        float b = (t - i) * (1.0f / EXP_TABLE_STEPS);
+        return expTable[i] * (1.0f - b * (1.0f - b * (0.5f - b * (1.0f / 6.0f))));
+    }
+};
+
+static CoefTables* coefTables = nullptr;
+
+// Per-sample constants of the resonator type shapings. The original values
+// were tuned at 48kHz; they are rescaled here so the shapings keep the same
+// time behaviour at other sample rates. Recomputed only when the rate changes.
+struct ResonatorConstants {
+    float sampleRate = 0.0f;
+    float ageStep = 0.0f;           // Seconds per sample
+    float fastDecay = 0.0f;         // Fast Decay: env multiplier per sample
+    float dynGainBase = 0.0f;       // Dyn Gain: gain *= base + slope * env
+    float dynGainSlope = 0.0f;
+    float ageDamping = 0.0f;        // Age Damping: gain *= 1 - ageDamping * age
+    float envGainBase = 0.0f;       // Env Gain: gain *= base + slope * env
+    float envGainSlope = 0.0f;
+    float outDamp = 0.0f;           // Out Damp: state multiplier per sample
+    float dynDecayBase = 0.0f;      // Dyn Decay: env *= base - slope * env
+    float dynDecaySlope = 0.0f;
+
+    void update(float sr) {
+        sampleRate = sr;
+        float k = 48000.0f / sr;    // Reference rate / actual rate
+        ageStep = 1.0f / sr;
+        fastDecay = fastPow(0.9985f, k);
+        dynGainBase = 1.0f - 0.001f * k;
+        dynGainSlope = 0.001f * k;
+        ageDamping = 0.00002f * k;
+        envGainBase = 1.0f - 0.005f * k;
+        envGainSlope = 0.005f * k;
+        outDamp = fastPow(0.9995f, k);
+        dynDecayBase = 1.0f - 0.0002f * k;
+        dynDecaySlope = 0.0001f * k;
+    }
+};
+
+//--------------------------------------------------------------
+// ModalBank: all modal resonators of one voice, structure-of-arrays
+//--------------------------------------------------------------
+// Every coefficient and state variable lives in its own contiguous array.
+// On a SIMD target the arrays are padded to MODAL_SIMD_WIDTH modes, so the
+// kernels can keep one vector of modes in a register; lanes between count and
+// padded are kept at zero (no gain, no state) and stay silent. The Cortex-M7
+// FPU is scalar, so there the width is 1 and no padding lane is computed.
+#ifndef MODAL_SIMD_WIDTH
+#if defined(__ARM_NEON) || defined(__SSE2__)
+#define MODAL_SIMD_WIDTH 4
+#else
+#define MODAL_SIMD_WIDTH 1
+#endif
+#endif
+// Modes the kernels run side by side (a multiple of MODAL_SIMD_WIDTH). Their
+// recursions are independent, so interleaving them keeps a scalar FPU busy
+// instead of waiting on the latency of one mode's feedback
+#ifndef MODAL_INTERLEAVE
+#define MODAL_INTERLEAVE 4
+#endif
+#define MODAL_PADDED(n) (((n) + MODAL_SIMD_WIDTH - 1) / MODAL_SIMD_WIDTH * MODAL_SIMD_WIDTH)
+
+#define MODE_AUDIBLE_LEVEL 0.0005f  // A mode below this output amplitude is dropped
+#define MODE_LIFE_FOREVER 0x7FFFFFFF
+
+// Resonator engines. Biquad: direct form two-pole, a1 = -2 r cos(w), a2 = r^2,
+// y1/y2 are the last two outputs; pitch is fixed at trigger. Rotation: coupled
+// form, the state (y2, y1) is a phasor turned by w and scaled by r every
+// sample, a1 = r cos(w), a2 = r sin(w); retuning only needs the new sine and
+// cosine, and the decay stays exact however low the mode is.
+enum {
+    kEngineBiquad = 0,
+    kEngineRotation
+};
+
+// Engine a voice's modes run on. The resonator types that feed a mode's state
+// back into its input (Highpass, Bright, Even Harm, Odd Harm) are defined on
+// the biquad's last two outputs; the rotation engine scales its input by
+// 1 / sin(w), which would scale that feedback too and drive the low modes
+// unstable, so these types always run on the biquad (and do not glide).
+static inline int modalEngine(int engine, int type) {
+    if (type == 9 || type == 10 || type == 14 || type == 16) return kEngineBiquad;
+    return engine;
+}
+
+struct ModalBank {
+    // Hot: touched every sample
+    float* y1;                              // Previous outputs (for difference equation)
+    float* y2;
+    float* a1;                              // Filter coefficients
+    float* a2;
+    float* gain;                            // Resonator gain
+    float* env;                             // Envelope (for exponential decay)
+    float* panL;                            // Stereo placement of the mode (1 = centre)
+    float* panR;
+    // Cold: only touched on trigger
+    float* freq;                            // Resonance frequency (Hz)
+    float* bandwidth;                       // Bandwidth (Hz)
+    float* r;                               // Pole radius (for coefficient calculation)
+    int32_t* life;                          // Samples until the mode falls below MODE_AUDIBLE_LEVEL
+    float age = 0.0f;                       // Age in seconds since trigger (shared by all modes)
+    int count = 0;                          // Modes in use
+    int padded = 0;                         // count rounded up to MODAL_SIMD_WIDTH
+    int capacity = 0;                       // Modes the arrays hold
+    int type = 0;                           // Resonator type it was struck with (selects its kernel)
+    int engine = kEngineBiquad;             // Resonator engine of its modes
+
+    static const int kNumArrays = 12;
+
+    // Floats of mode memory one bank needs for up to maxModes modes
+    static int memorySize(int maxModes) { return kNumArrays * MODAL_PADDED(maxModes); }
+
+    // Point the arrays into mode memory of memorySize(maxModes) floats, 16 byte aligned
+    void attach(float* mem, int maxModes) {
+        int stride = MODAL_PADDED(maxModes);
+        y1 = mem;                   y2 = mem + stride;
+        a1 = mem + 2 * stride;      a2 = mem + 3 * stride;
+        gain = mem + 4 * stride;    env = mem + 5 * stride;
+        freq = mem + 6 * stride;    bandwidth = mem + 7 * stride;
+        r = mem + 8 * stride;       life = (int32_t*)(mem + 9 * stride);
+        panL = mem + 10 * stride;   panR = mem + 11 * stride;
+        memset(mem, 0, memorySize(maxModes) * sizeof(float));
+        capacity = maxModes;
+        count = padded = 0;
+        age = 0.0f;
+    }
+
+    // Set the number of modes in use and silence the padding lanes (call on trigger)
+    void setCount(int n) {
+        count = n;
+        padded = MODAL_PADDED(n);
+        age = 0.0f;
+        for (int m = n; m < padded; ++m) {
+            y1[m] = y2[m] = a1[m] = a2[m] = gain[m] = env[m] = 0.0f;
+        }
+    }
+
+    // Closed-form lifetime of every mode (call once the excitation is over).
+    // The amplitude of a decaying two-pole oscillation follows from its state:
+    // A^2 = (y1^2 + a2 y2^2 + a1 y1 y2) / sin^2(w), and it shrinks by r = sqrt(a2)
+    // per sample, so the mode is inaudible after ln(A / level) / -ln(r) samples.
+    // The resonator shapings only ever speed the decay up, except Out HP
+    // which moves the pole outwards; both are taken into account where they
+    // are a fixed rate per sample.
+    void estimateLifetimes(int type, const ResonatorConstants& k) {
+        float extraDecay = 0.0f;
+        if (type == 1) extraDecay = -fastLog(k.fastDecay);         // Fast Decay
+        if (type == 12) extraDecay = -fastLog(k.outDamp);          // Out Damp
+        if (type == 19) extraDecay = -fastLog(k.dynDecayBase);     // Dyn Decay (at least)
+        for (int m = 0; m < count; ++m) {
+            float a2e = a2[m];
+            if (type == 18) a2e -= 0.0001f * a1[m]; // Out HP
+            float amp = amplitude(m);
+            float decayPerSample = ((engine == kEngineRotation) ? -fastLog(r[m]) : -0.5f * fastLog(a2e)) + extraDecay;
+            if (amp <= MODE_AUDIBLE_LEVEL) life[m] = 0;
+            else if (decayPerSample <= 0.0f) life[m] = MODE_LIFE_FOREVER;
+            else life[m] = (int)fminf(fastLog(amp / MODE_AUDIBLE_LEVEL) / decayPerSample, (float)MODE_LIFE_FOREVER);
+        }
+    }
+
+    // Current amplitude of mode m, from its two state samples
+    float amplitude(int m) const {
+        if (engine == kEngineRotation) return sqrtf(y1[m] * y1[m] + y2[m] * y2[m]) * env[m];
+        float c = (r[m] > 0.0f) ? -a1[m] / (2.0f * r[m]) : 1.0f;
+        float sin2 = fmaxf(1.0f - c * c, 1e-12f);
+        float amp2 = (y1[m] * y1[m] + a2[m] * y2[m] * y2[m] + a1[m] * y1[m] * y2[m]) / sin2;
+        return sqrtf(fmaxf(amp2, 0.0f)) * env[m];
+    }
+
+    // Fade the quietest upper modes out until only keep are left sounding
+    // (CPU governor). A shed mode is not cut: its decay is sped up so it falls
+    // below MODE_AUDIBLE_LEVEL within fadeFrames samples, then cull() drops
+    // it. Modes that already die out that fast count as shed; the
+    // fundamental (mode 0) is never picked.
+    void shed(int keep, int fadeFrames) {
+        int sounding = 0;
+        for (int m = 0; m < count; ++m)
+            if (!fadesWithin(m, fadeFrames)) sounding++;
+        while (sounding > keep) {
+            int quietest = -1;
+            float minAmp = 0.0f;
+            for (int m = 1; m < count; ++m) {
+                if (fadesWithin(m, fadeFrames)) continue;
+                float a = amplitude(m);
+                if (quietest < 0 || a < minAmp) { minAmp = a; quietest = m; }
+            }
+            if (quietest < 0) break;
+            fadeMode(quietest, fadeFrames);
+            sounding--;
+        }
+    }
+
+    // True when mode m falls below MODE_AUDIBLE_LEVEL within frames samples
+    // (with some slack for the approximations)
+    bool fadesWithin(int m, int frames) const {
+        float amp = amplitude(m);
+        if (amp <= MODE_AUDIBLE_LEVEL) return true;
+        return fastLog(amp / MODE_AUDIBLE_LEVEL) <= -fastLog(r[m]) * frames * 1.1f;
+    }
+
+    // Speed up the decay of mode m so it falls below MODE_AUDIBLE_LEVEL in frames samples
+    void fadeMode(int m, int frames) {
+        float amp = amplitude(m);
+        if (amp > MODE_AUDIBLE_LEVEL)
+            setBandwidth(m, fastLog(amp / MODE_AUDIBLE_LEVEL) * SAMPLE_RATE / (M_PI * frames));
+        life[m] = frames;
+    }
+
+    // Age the modes by n samples and drop the ones that have died out.
+    // A dropped mode is replaced by the last active one, so the bank stays
+    // dense and the kernels only ever run over live modes.
+    void cull(int n) {
+        int oldPadded = padded;
+        for (int m = 0; m < count; ) {
+            if (life[m] != MODE_LIFE_FOREVER) life[m] -= n;
+            if (life[m] > 0) { ++m; continue; }
+            remove(m);
+        }
+        padded = MODAL_PADDED(count);
+        for (int m = count; m < oldPadded; ++m) {
+            y1[m] = y2[m] = a1[m] = a2[m] = gain[m] = env[m] = 0.0f;
+        }
+    }
+
+    // Replace mode m by the last one (the caller re-zeroes the padding)
+    void remove(int m) {
+        int last = --count;
+        if (m != last) {
+            y1[m] = y1[last]; y2[m] = y2[last];
+            a1[m] = a1[last]; a2[m] = a2[last];
+            gain[m] = gain[last]; env[m] = env[last];
+            panL[m] = panL[last]; panR[m] = panR[last];
+            freq[m] = freq[last]; bandwidth[m] = bandwidth[last];
+            r[m] = r[last]; life[m] = life[last];
+        }
+    }
+
+    // Analytic strike (call on trigger, after init): adds the initial state
+    // that makes the free decay equal to the response to x[0..n) for every
+    // sample from n on, so the excitation never has to be fed sample by sample.
+    // The impulse response h is extended backwards through the recursion,
+    // state = sum of x[k] * (h[-1-k], h[-2-k]).
+    // Rotation engine: the input enters u, so the phasor gets x[k] * (1, 0)
+    // turned back by k samples, i.e. multiplied by the inverse rotation.
+    void strike(const float* x, int n) {
+        if (engine == kEngineRotation) {
+            for (int m = 0; m < padded; ++m) {
+                float det = a1[m] * a1[m] + a2[m] * a2[m];
+                float inv = (det > 0.0f) ? 1.0f / det : 0.0f;
+                float pu = 1.0f, pv = 0.0f;
+                float su = 0.0f, sv = 0.0f;
+                for (int k = 0; k < n; ++k) {
+                    su += x[k] * pu;
+                    sv += x[k] * pv;
+                    float nu = (a1[m] * pu + a2[m] * pv) * inv;
+                    pv = (a1[m] * pv - a2[m] * pu) * inv;
+                    pu = nu;
+                }
+                y2[m] += gain[m] * su;
+                y1[m] += gain[m] * sv;
+            }
+            return;
+        }
+        for (int m = 0; m < padded; ++m) {
+            float inv = (a2[m] > 0.0f) ? 1.0f / a2[m] : 0.0f;
+            float u = 0.0f, w = -inv;           // h[-1-k], h[-2-k]
+            float s1 = 0.0f, s2 = 0.0f;
+            for (int k = 0; k < n; ++k) {
+                s1 += x[k] * u;
+                s2 += x[k] * w;
+                float next = -(u + a1[m] * w) * inv;
+                u = w;
+                w = next;
+            }
+            y1[m] += gain[m] * s1;
+            y2[m] += gain[m] * s2;
+        }
+    }
+
+    // Mode ringing at f (within tolerance, relative), -1 if there is none
+    int findMode(float f, float tolerance) const {
+        for (int m = 0; m < count; ++m)
+            if (fabsf(freq[m] - f) < tolerance * f) return m;
+        return -1;
+    }
+
+    // Re-strike (call on trigger of a ringing voice): fold the envelope into
+    // the state so the output is unchanged and new input adds on top of it.
+    void rearm() {
+        for (int m = 0; m < count; ++m) {
+            y1[m] *= env[m];
+            y2[m] *= env[m];
+            env[m] = 1.0f;
+        }
         age = 0.0f;
+    }
+
+    // Append a mode (re-strike brings back one that had died out), -1 when full
+    int add() {
+        if (count >= capacity) return -1;
+        int m = count++;
+        padded = MODAL_PADDED(count);
+        return m;
+    }
+
+    // Place one mode in the stereo field, pan in [-1, 1] (call on trigger).
+    // Equal power, normalised so that the centre is unity on both sides.
+    void setPan(int m, float pan) {
+        if (pan == 0.0f) { panL[m] = panR[m] = 1.0f; return; }
+        if (pan < -1.0f) pan = -1.0f;
+        if (pan > 1.0f) pan = 1.0f;
+        float angle = (pan + 1.0f) * (float)(M_PI / 4.0);
+        panL[m] = 1.41421356f * fastCos(angle);
+        panR[m] = 1.41421356f * fastSin(angle);
+    }
+
+    // Widen the bandwidth of every mode by scale, keeping its frequency and state
+    void damp(float scale) {
+        for (int m = 0; m < count; ++m) setBandwidth(m, bandwidth[m] * scale);
+    }
+
+    // New bandwidth for mode m, keeping its frequency and state
+    void setBandwidth(int m, float bw) {
+        bandwidth[m] = bw;
+        if (engine == kEngineRotation) {
+            float c = (r[m] > 0.0f) ? a1[m] / r[m] : 1.0f;
+            float s = (r[m] > 0.0f) ? a2[m] / r[m] : 0.0f;
+            r[m] = coefTables->expNeg(M_PI * bandwidth[m] / SAMPLE_RATE);
+            a1[m] = r[m] * c;
+            a2[m] = r[m] * s;
+            return;
+        }
+        float c = (r[m] > 0.0f) ? -a1[m] / (2.0f * r[m]) : 1.0f;
+        r[m] = coefTables->expNeg(M_PI * bandwidth[m] / SAMPLE_RATE);
+        a1[m] = -2.0f * r[m] * c;
+        a2[m] = r[m] * r[m];
+    }
+
+    // Rotation engine: move every mode by ratio, keeping its state and decay (glide, once per block)
+    void retune(float ratio) {
+        for (int m = 0; m < count; ++m) {
+            freq[m] = fminf(freq[m] * ratio, SAMPLE_RATE * 0.35f);
+            float w = 2.0f * M_PI * freq[m] / SAMPLE_RATE;
+            a1[m] = r[m] * fastCos(w);
+            a2[m] = r[m] * fastSin(w);
+        }
+    }
+
+    // Set the strike gain of mode m; on the rotation engine it is scaled to
+    // match the biquad's peak gain of 1 / sin(w) (a2 = r sin w)
+    void setGain(int m, float g) {
+        gain[m] = (engine == kEngineRotation) ? g * r[m] / a2[m] : g;
+    }
+
+    // Initialize one mode (call on trigger)
+    void init(int m, float f, float g, float bw, int type, Rng& rng) {
+        if (type == 3) bw *= 1.5f; // For "damped" type, increase bandwidth
+        bandwidth[m] = fmaxf(bw, 0.05f);
+        env[m] = 1.0f;
         // Randomize filter state to avoid phase artifacts
-        y1 = ((rand() % 2000) / 1000.0f - 1.0f) * 0.001f;
-        y2 = ((rand() % 2000) / 1000.0f - 1.0f) * 0.001f;
-        freq = f;
+        y1[m] = rng.bipolar() * 0.001f;
+        y2[m] = rng.bipolar() * 0.001f;
+        freq[m] = f;
         // Calculate filter coefficients
-        r = expf(-M_PI * bandwidth / SAMPLE_RATE);
-        a1 = -2.0f * r * cosf(2.0f * M_PI * freq / SAMPLE_RATE);
-        a2 = r * r;
+        r[m] = coefTables->expNeg(M_PI * bandwidth[m] / SAMPLE_RATE);
+        if (engine == kEngineRotation) {
+            float w = 2.0f * M_PI * freq[m] / SAMPLE_RATE;
+            a1[m] = r[m] * fastCos(w);
+            a2[m] = r[m] * fastSin(w);
+        } else {
+            a1[m] = -2.0f * r[m] * coefTables->cos(2.0f * M_PI * freq[m] / SAMPLE_RATE);
+            a2[m] = r[m] * r[m];
+        }
+        setGain(m, g);
     }
+};
 
-    // Process one sample for this mode
-    float process(float x,int type = 0) {
-       
-        
-        // Resonator type shapings
-        switch (type) {
-            case 0: break; // Standard
-            case 1: env *= 0.9985f; break; // Fast Decay
-            case 2: if (x > 1.0f) x = 1.0f; if (x < -1.0f) x = -1.0f; break; // Soft Clip
-            case 3: gain *= (0.999f + 0.001f * env); break; // Dynamic Gain
-            case 4: x *= env; break; // Envelope Damping
-            case 5: gain *= (1.0f - 0.00002f * age); break; // Age Damping
-            case 6: if (x > 0) x *= 1.01f; else x *= 0.99f; break; // Gentle Asymmetry
-            case 7: gain *= (0.995f + 0.005f * env); break; // Env Gain
-            case 8: if (x > 0.8f) x = 0.8f + 0.1f * (x - 0.8f); if (x < -0.8f) x = -0.8f + 0.1f * (x + 0.8f); break; // Limiter
-            case 9: x = x - 0.01f * y1; break; // Highpass
-            case 10: x += 0.0001f * (x - y1); break; // Bright
-            case 11: if (x > env) x = env + 0.1f * (x - env); if (x < -env) x = -env + 0.1f * (x + env); break; // Env Clip
-            case 12: y1 *= 0.9995f; y2 *= 0.9995f; break; // Out Damp
-            case 13: x = -x; break; // Phase Flip
-            case 14: x += 0.00005f * y1; break; // Even Harm
-            case 15: if (y1 > 1.0f) y1 = 1.0f; if (y1 < -1.0f) y1 = -1.0f; break; // Out Lim
-            case 16: x += 0.00005f * y2; break; // Odd Harm
-            case 17: if (x > 0) x *= (1.0f + 0.005f * env); else x *= (1.0f - 0.005f * env); break; // Env Asym
-            case 18: y1 -= 0.0001f * y2; break; // Out HP
-            case 19: env *= (0.9998f - 0.0001f * env); break; // Dyn Decay
-            default: break;
+//--------------------------------------------------------------
+// Resonator type kernels
+//--------------------------------------------------------------
+// Resonator type shaping for one mode, resolved at compile time per kernel
+template <int Type>
+inline float shapeMode(float x, float& y1, float& y2, float& gain, float& env, float age, const ResonatorConstants& k) {
+    if (Type == 1) env *= k.fastDecay; // Fast Decay
+    if (Type == 2) { if (x > 1.0f) x = 1.0f; if (x < -1.0f) x = -1.0f; } // Soft Clip
+    if (Type == 3) gain *= (k.dynGainBase + k.dynGainSlope * env); // Dynamic Gain
+    if (Type == 4) x *= env; // Envelope Damping
+    if (Type == 5) gain *= (1.0f - k.ageDamping * age); // Age Damping
+    if (Type == 6) { if (x > 0) x *= 1.01f; else x *= 0.99f; } // Gentle Asymmetry
+    if (Type == 7) gain *= (k.envGainBase + k.envGainSlope * env); // Env Gain
+    if (Type == 8) { if (x > 0.8f) x = 0.8f + 0.1f * (x - 0.8f); if (x < -0.8f) x = -0.8f + 0.1f * (x + 0.8f); } // Limiter
+    if (Type == 9) x = x - 0.01f * y1; // Highpass
+    if (Type == 10) x += 0.0001f * (x - y1); // Bright
+    if (Type == 11) { if (x > env) x = env + 0.1f * (x - env); if (x < -env) x = -env + 0.1f * (x + env); } // Env Clip
+    if (Type == 12) { y1 *= k.outDamp; y2 *= k.outDamp; } // Out Damp
+    if (Type == 13) x = -x; // Phase Flip
+    if (Type == 14) x += 0.00005f * y1; // Even Harm
+    if (Type == 15) { if (y1 > 1.0f) y1 = 1.0f; if (y1 < -1.0f) y1 = -1.0f; } // Out Lim
+    if (Type == 16) x += 0.00005f * y2; // Odd Harm
+    if (Type == 17) { if (x > 0) x *= (1.0f + 0.005f * env); else x *= (1.0f - 0.005f * env); } // Env Asym
+    if (Type == 18) y1 -= 0.0001f * y2; // Out HP
+    if (Type == 19) env *= (k.dynDecayBase - k.dynDecaySlope * env); // Dyn Decay
+    return x;
+}
+
+// Render n frames of Width modes from base on, adding their panned sum to
+// outL[] and outR[]. The modes and the shaping constants are loaded into
+// locals and run through the whole block, so they stay in registers: read
+// through the references, every store to outL[] / outR[] (which may alias
+// them) would force a reload.
+// Without Input the excitation is over (or was applied as an analytic strike)
+// and the modes run as a pure free-decay recursion; x is not read.
+// Rotation selects the coupled form engine (one more multiply per mode).
+template <int Type, bool Input, bool Rotation, int Width>
+inline void renderModeGroup(ModalBank& b, int base, const float* x, float* outL, float* outR, int n, const ResonatorConstants& constants) {
+    const ResonatorConstants k = constants;
+    float y1[Width], y2[Width], a1[Width], a2[Width];
+    float gain[Width], env[Width], panL[Width], panR[Width];
+    for (int l = 0; l < Width; ++l) {
+        y1[l] = b.y1[base + l]; y2[l] = b.y2[base + l];
+        a1[l] = b.a1[base + l]; a2[l] = b.a2[base + l];
+        gain[l] = b.gain[base + l]; env[l] = b.env[base + l];
+        panL[l] = b.panL[base + l]; panR[l] = b.panR[base + l];
+    }
+    float age = b.age;
+    for (int f = 0; f < n; ++f) {
+        float sumL = 0.0f, sumR = 0.0f;
+        for (int l = 0; l < Width; ++l) {
+            float in = shapeMode<Type>(Input ? x[f] : 0.0f, y1[l], y2[l], gain[l], env[l], age, k);
+            float y;
+            if (Rotation) {
+                // (u, v) = (y2, y1): rotate by w, scale by r, input into u
+                float u = a1[l] * y2[l] - a2[l] * y1[l] + gain[l] * in;
+                y = a2[l] * y2[l] + a1[l] * y1[l];
+                y2[l] = u;
+            } else {
+                y = gain[l] * in - a1[l] * y1[l] - a2[l] * y2[l];
+                y2[l] = y1[l];
+            }
+            y1[l] = y;
+            float out = y * env[l];
+            sumL += out * panL[l];
+            sumR += out * panR[l];
+        }
+        outL[f] += sumL;
+        outR[f] += sumR;
+        age += k.ageStep;
+    }
+    for (int l = 0; l < Width; ++l) {
+        b.y1[base + l] = y1[l]; b.y2[base + l] = y2[l];
+        b.gain[base + l] = gain[l]; b.env[base + l] = env[l];
+    }
+}
+
+// Render n frames of one bank: writes the panned mode sums to outL[] and outR[]
+// and returns their mean square. MODAL_INTERLEAVE modes at a time, then the
+// rest MODAL_SIMD_WIDTH at a time.
+template <int Type, bool Input, bool Rotation>
+float renderModes(ModalBank& b, const float* x, float* outL, float* outR, int n, const ResonatorConstants& k) {
+    for (int f = 0; f < n; ++f) outL[f] = outR[f] = 0.0f;
+    int base = 0;
+    for (; base + MODAL_INTERLEAVE <= b.padded; base += MODAL_INTERLEAVE)
+        renderModeGroup<Type, Input, Rotation, MODAL_INTERLEAVE>(b, base, x, outL, outR, n, k);
+    for (; base < b.padded; base += MODAL_SIMD_WIDTH)
+        renderModeGroup<Type, Input, Rotation, MODAL_SIMD_WIDTH>(b, base, x, outL, outR, n, k);
+    b.age += n * k.ageStep;
+
+    // Mean square of the output: the voice's loudness for the allocator
+    float energy = 0.0f;
+    for (int f = 0; f < n; ++f) energy += outL[f] * outL[f] + outR[f] * outR[f];
+    return energy / n;
+}
+
+// Dispatch table: one kernel per engine and resonator type, with and without excitation input, picked once per run
+typedef float (*ModalKernel)(ModalBank&, const float*, float*, float*, int, const ResonatorConstants&);
+
+static const ModalKernel modalKernels[2][2][20] = {
+    {  // Biquad
+        {  // Free decay
+            renderModes<0, false, false>, renderModes<1, false, false>, renderModes<2, false, false>, renderModes<3, false, false>, renderModes<4, false, false>,
+            renderModes<5, false, false>, renderModes<6, false, false>, renderModes<7, false, false>, renderModes<8, false, false>, renderModes<9, false, false>,
+            renderModes<10, false, false>, renderModes<11, false, false>, renderModes<12, false, false>, renderModes<13, false, false>, renderModes<14, false, false>,
+            renderModes<15, false, false>, renderModes<16, false, false>, renderModes<17, false, false>, renderModes<18, false, false>, renderModes<19, false, false>
+        },
+        {  // Driven by the excitation
+            renderModes<0, true, false>, renderModes<1, true, false>, renderModes<2, true, false>, renderModes<3, true, false>, renderModes<4, true, false>,
+            renderModes<5, true, false>, renderModes<6, true, false>, renderModes<7, true, false>, renderModes<8, true, false>, renderModes<9, true, false>,
+            renderModes<10, true, false>, renderModes<11, true, false>, renderModes<12, true, false>, renderModes<13, true, false>, renderModes<14, true, false>,
+            renderModes<15, true, false>, renderModes<16, true, false>, renderModes<17, true, false>, renderModes<18, true, false>, renderModes<19, true, false>
+        }
+    },
+    {  // Rotation
+        {  // Free decay
+            renderModes<0, false, true>, renderModes<1, false, true>, renderModes<2, false, true>, renderModes<3, false, true>, renderModes<4, false, true>,
+            renderModes<5, false, true>, renderModes<6, false, true>, renderModes<7, false, true>, renderModes<8, false, true>, renderModes<9, false, true>,
+            renderModes<10, false, true>, renderModes<11, false, true>, renderModes<12, false, true>, renderModes<13, false, true>, renderModes<14, false, true>,
+            renderModes<15, false, true>, renderModes<16, false, true>, renderModes<17, false, true>, renderModes<18, false, true>, renderModes<19, false, true>
+        },
+        {  // Driven by the excitation
+            renderModes<0, true, true>, renderModes<1, true, true>, renderModes<2, true, true>, renderModes<3, true, true>, renderModes<4, true, true>,
+            renderModes<5, true, true>, renderModes<6, true, true>, renderModes<7, true, true>, renderModes<8, true, true>, renderModes<9, true, true>,
+            renderModes<10, true, true>, renderModes<11, true, true>, renderModes<12, true, true>, renderModes<13, true, true>, renderModes<14, true, true>,
+            renderModes<15, true, true>, renderModes<16, true, true>, renderModes<17, true, true>, renderModes<18, true, true>, renderModes<19, true, true>
         }
-        float y = gain * x - a1 * y1 - a2 * y2;
-        y2 = y1;
-        y1 = y;
-        age += 1.0f / SAMPLE_RATE;
-        return y * env;
     }
 };
 
 
-// Excitation: buffer for the initial impulse (not for continuous noise)
+// Excitation shapes: rendered once at load time into a shared read-only bank
+//
+// Every shape (x the instrument "strike" variant) is generated, smoothed, soft
+// clipped and attenuated here, so a voice only keeps a pointer, a length and
+// a read position and a trigger costs nothing. The shapes are at most 64
+// samples long; after the smoothing lowpass their tail is below 1e-30 well
+// before EXCITATION_MAX_LENGTH.
+#define EXCITATION_NUM_SHAPES 17
+#define EXCITATION_MAX_LENGTH 128
+
+struct ExcitationShape {
+    int length;                             // Samples up to the last audible one
+    float data[EXCITATION_MAX_LENGTH];      // Soft clipped and attenuated
+};
 
-struct Excitation {
-    float buffer[EXCITATION_BUFFER_SIZE];
-    int pos;
-    float mixNoise = 0.0f;
+struct ExcitationBank {
+    ExcitationShape shapes[2][EXCITATION_NUM_SHAPES + 1];  // [strike variant][type], then the fallback
 
-    // Get next sample from the excitation buffer
-    float next() {
-        float value = (pos < EXCITATION_BUFFER_SIZE ? buffer[pos++] : 0.0f);
-        return softclip(value) * 0.1f; // Softclip and attenuate
+    // Shape for an excitation type and instrument; a type out of range (a
+    // negative Exciter CV) gets the single impulse fallback
+    const ExcitationShape& get(int type, int instrType) const {
+        if (type < 0 || type >= EXCITATION_NUM_SHAPES) type = EXCITATION_NUM_SHAPES;
+        return shapes[(instrType == 3 || instrType == 4) ? 1 : 0][type];
     }
 
-    // Generate the excitation buffer (impulse shape)
-    void generate(int type, int instrType, float noiseAmount = 0.0f, int a = 64, int d = 128, float s = 0.0f, int r = 256) {
-        if (!noiseInit) {
-            for (int i = 0; i < EXCITATION_NOISETABLE_SIZE; ++i)
-                noiseTable[i] = ((rand() % 2000) / 1000.0f) - 1.0f;
-            noiseInit = true;
-        }
-        // Reset position 
-        pos = 0;
+    void build() {
+        Rng rng;    // Fixed seed: the Noise Burst shape is the same on every load
+        for (int strike = 0; strike < 2; ++strike)
+            for (int type = 0; type <= EXCITATION_NUM_SHAPES; ++type)
+                render(shapes[strike][type], type, strike != 0, rng);
+    }
 
+    // Generate one excitation shape (impulse shape)
+    static void render(ExcitationShape& shape, int type, bool strike, Rng& rng) {
+        float buf[EXCITATION_MAX_LENGTH];
         // Clear the buffer
-        for (int i = 0; i < EXCITATION_BUFFER_SIZE; ++i) buffer[i] = 0.0f;
+        for (int i = 0; i < EXCITATION_MAX_LENGTH; ++i) buf[i] = 0.0f;
 
 
 // Different excitation shapes
         switch (type) {
 // Hard finger: loud, longer impulse
-             case 0: for (int i = 0; i < 32; ++i) buffer[i] = 0.7f * expf(-0.09f * i);
+             case 0: for (int i = 0; i < 32; ++i) buf[i] = 0.7f * coefTables->expNeg(0.09f * i);
                 break;
 // Soft finger: short, sharp impulse
-            case 1: buffer[0] = 1.0f; buffer[1] = 0.5f;
+            case 1: buf[0] = 1.0f; buf[1] = 0.5f;
                 break;
 // Hand: wider, round smashy impulse               
-            case 2: for (int i = 0; i < 48; ++i) buffer[i] = 0.6f * expf(-0.06f * i);
+            case 2: for (int i = 0; i < 48; ++i) buf[i] = 0.6f * coefTables->expNeg(0.06f * i);
                 break;
 // Hard mallet: Loud, slowly rising                
-            case 3: for (int i = 0; i < 64; ++i) buffer[i] = 0.5f * (1.0f * expf(-0.04f * i));
+            case 3: for (int i = 0; i < 64; ++i) buf[i] = 0.5f * (1.0f * coefTables->expNeg(0.04f * i));
                 break;
 // Soft mallet: very short, smooth
-            case 4: buffer[0] = 1.0f; buffer[1] = -0.5f; buffer[2] = 0.2f;
+            case 4: buf[0] = 1.0f; buf[1] = -0.5f; buf[2] = 0.2f;
                 break;
 // Handpan-like: longer, smoother impulse
-            case 5: for (int i = 0; i < 8; ++i) buffer[i] = 1.0f - i * 0.1f;
+            case 5: for (int i = 0; i < 8; ++i) buf[i] = 1.0f - i * 0.1f;
                 break;
 // Steel drum-like: sharp, clear attack
-            case 6: buffer[0] = 1.0f; buffer[1] = 0.6f; buffer[2] = 0.2f;
+            case 6: buf[0] = 1.0f; buf[1] = 0.6f; buf[2] = 0.2f;
                break;
 // Bell-like: longer, smoother decay
-            case 7: for (int i = 0; i < 12; ++i) buffer[i] = 1.0f - (i / 2.0f);
+            case 7: for (int i = 0; i < 12; ++i) buf[i] = 1.0f - (i / 2.0f);
                break;
 // Chime-like: bright, ringing
-            case 8: for (int i = 0; i < 4; ++i) buffer[i] = 0.5f - i *0.2f;
+            case 8: for (int i = 0; i < 4; ++i) buf[i] = 0.5f - i *0.2f;
                 break;
 // Custom: user-defined shape
-            case 9: buffer[0] = 1.0f; buffer[1] = 0.4f; buffer[2] = 0.0f;
+            case 9: buf[0] = 1.0f; buf[1] = 0.4f; buf[2] = 0.0f;
                 break;
 // Muted slap
-            case 10:  buffer[0] = 0.7f; buffer[1] = -0.3f;
+            case 10:  buf[0] = 0.7f; buf[1] = -0.3f;
                 break;
 // Brush
-            case 11:  for (int i = 0; i < 4; ++i) buffer[i] = 0.03f * i - 0.4f;
+            case 11:  for (int i = 0; i < 4; ++i) buf[i] = 0.03f * i - 0.4f;
                 break;
 // Double tap
-            case 12: buffer[0] = 1.0f; buffer[8] = 0.7f;
+            case 12: buf[0] = 1.0f; buf[8] = 0.7f;
                 break;  
 // Reverse                
-            case 13: for (int i = 0; i < 16; ++i) buffer[i] =0.02f * i - 0.6f;
+            case 13: for (int i = 0; i < 16; ++i) buf[i] =0.02f * i - 0.6f;
                 break;  
 // Noise burst, randomized
-            case 14: for (int i = 0; i < 24; ++i) buffer[i] = fastWhiteNoise() * expf(-0.2f * i);
+            case 14: for (int i = 0; i < 24; ++i) buf[i] = rng.bipolar() * coefTables->expNeg(0.2f * i);
                 break;
 // Triangle pulse
-            case 15:   buffer[0] = 0.8f; buffer[1] = 0.4f;
+            case 15:   buf[0] = 0.8f; buf[1] = 0.4f;
                 break;  
 // Sine burst
-            case 16:   buffer[0] = 0.2f; buffer[1] = 0.6f;
+            case 16:   buf[0] = 0.2f; buf[1] = 0.6f;
                 break;    
 // Fallback: single impulse
-            default:  buffer[0] = 1.0f; break;
+            default:  buf[0] = 1.0f; break;
         
 
             
@@ -279,22 +812,74 @@ struct Excitation {
         
 
         // Add a little "strike" for some instruments
-        if (instrType == 3 || instrType == 4) {
-            for (int i = 0; i < 16; ++i) buffer[i] += 0.05f * sinf(i * 0.4f);
+        if (strike) {
+            for (int i = 0; i < 16; ++i) buf[i] += 0.05f * fastSin(i * 0.4f);
         }
 
         // Excitation smoothing (simple lowpass)
         float prev = 0.0f;
-        for (int i = 0; i < EXCITATION_BUFFER_SIZE; ++i) {
-            buffer[i] = 0.7f * buffer[i] + 0.3f * prev;
-            prev = buffer[i];
+        for (int i = 0; i < EXCITATION_MAX_LENGTH; ++i) {
+            buf[i] = 0.7f * buf[i] + 0.3f * prev;
+            prev = buf[i];
         }
 
         // Ensure at least 3 nonzero values
-        if (fabsf(buffer[0]) < 0.001f && fabsf(buffer[1]) < 0.001f && fabsf(buffer[2]) < 0.001f) {
-            buffer[0] = 0.1f;
-            buffer[1] = 0.2f;
-            buffer[2] = 0.3f;
+        if (fabsf(buf[0]) < 0.001f && fabsf(buf[1]) < 0.001f && fabsf(buf[2]) < 0.001f) {
+            buf[0] = 0.1f;
+            buf[1] = 0.2f;
+            buf[2] = 0.3f;
+        }
+
+        // Softclip and attenuate, trim the silent tail
+        shape.length = 3;
+        for (int i = 0; i < EXCITATION_MAX_LENGTH; ++i) {
+            shape.data[i] = softclip(buf[i]) * 0.1f;
+            if (fabsf(shape.data[i]) > 1e-9f && i >= shape.length) shape.length = i + 1;
+        }
+    }
+};
+
+static ExcitationBank* excitationBank = nullptr;
+
+// Excitation: read position in a shape of the shared bank
+struct Excitation {
+    const float* data = nullptr;
+    int length = 0;                     // Samples to play
+    int pos = 0;
+    int shapeLength = 0;                // Samples in data
+    bool fractional = false;            // Onset between two frames
+    float tap[4];                       // Lagrange taps for data[pos + 1 - k]
+
+    // Get next sample of the excitation
+    float next() {
+        if (pos >= length) return 0.0f;
+        if (!fractional) return data[pos++];
+        float x = 0.0f;
+        for (int k = 0; k < 4; ++k) {
+            int i = pos + 1 - k;
+            if (i >= 0 && i < shapeLength) x += tap[k] * data[i];
+        }
+        pos++;
+        return x;
+    }
+
+    // Start an excitation shape (call on trigger). delay in [0, 1]: how far
+    // after the first frame the shape really starts, in samples. A 4-tap
+    // Lagrange fractional delay of 1 + delay (its flattest range) reads the
+    // shape one sample ahead, so the total delay is the fraction alone.
+    void start(int type, int instrType, float delay = 0.0f) {
+        const ExcitationShape& shape = excitationBank->get(type, instrType);
+        data = shape.data;
+        shapeLength = shape.length;
+        pos = 0;
+        fractional = (delay > 0.0f);
+        length = fractional ? shapeLength + 2 : shapeLength;
+        if (fractional) {
+            float D = 1.0f + delay;
+            tap[0] = -(D - 1.0f) * (D - 2.0f) * (D - 3.0f) * (1.0f / 6.0f);
+            tap[1] = D * (D - 2.0f) * (D - 3.0f) * 0.5f;
+            tap[2] = -D * (D - 1.0f) * (D - 3.0f) * 0.5f;
+            tap[3] = D * (D - 1.0f) * (D - 2.0f) * (1.0f / 6.0f);
         }
     }
 };
@@ -340,24 +925,218 @@ struct Envelope {
     float releaseStart = 0.0f;            // Start value for release stage   
 };
 
+// Noise state (filter memories, S&H counters and LFO phases of the noise types)
+struct NoiseState {
+    uint32_t noiseSeed = 1;
+    float pink = 0.0f;
+    float blueLast = 0.0f;
+    float hp1 = 0.0f, hp2 = 0.0f;
+    float lp1 = 0.0f, lp2 = 0.0f;
+    int sAndHcnt1 = 0, sAndHcnt2 = 0, sAndHcnt3 = 0;
+    float sAndH1 = 0.0f, sAndH2 = 0.0f, sAndH3 = 0.0f;
+    float chopperPhase1 = 0.0f, chopperPhase2 = 0.0f, chopperPhase3 = 0.0f;
+    float amPhase1 = 0.0f, amPhase2 = 0.0f;
+    float ringPhase1 = 0.0f, ringPhase2 = 0.0f;
+    float envPhase1 = 0.0f, envPhase2 = 0.0f;
+};
+
 // Voice: one polyphonic voice
 struct Voice {
-    bool active;                        // Is this voice active?
-    float age;                          // How long has this voice been active?
-    ModalResonator modes[MAX_MODES];    // Modal resonators
-    Excitation excitation;              // Excitation buffer
+    bool active = false;                // Is this voice active?
+    float age = 0.0f;                   // How long has this voice been active?
+    ModalBank bank;                     // Modal resonators
+    Excitation excitation;              // Excitation shape being played
     Envelope ampEnv;                    // Amplitude envelope (not used here)
     ExcitationAR excitationAR;          // AR envelope for excitation
+    int lane = 0;                       // Lane that played it
+    int instrType = 0;                  // Instrument it was struck as (re-strike)
+    int note = -1;                      // MIDI note, -1 when played from a gate
+    float strikeGain = 1.0f;            // Excitation level (MIDI velocity)
+    float damping = 1.0f;               // Bandwidth scale applied by note-off / aftertouch
+    float level = 0.0f;                 // Mean square output of the last run (stealing)
+    int nextFree = -1;                  // Free list link
+    float baseHz = 0.0f;                // Pitch it was struck at (re-strike)
+};
+
+// Stolen voices fade out over this long instead of being cut
+#define VOICE_FADE_SECONDS 0.003f
+#define VOICE_FADE_SLOTS 4          // Tails that can fade at the same time
+
+// Event queue: timestamped note events from outside step() (MIDI, or any
+// other source), played at their exact frame. Single producer (the source)
+// and single consumer (step()): the producer only moves head, the consumer
+// only moves tail, so neither side ever locks or waits.
+#define EVENT_QUEUE_SIZE 64         // Power of two
+
+enum {
+    kNoteOn = 0,
+    kNoteOff,
+    kNotePressure           // Polyphonic aftertouch
+};
+
+struct QueuedEvent {
+    uint32_t time;          // Sample clock of the frame it plays at
+    uint8_t kind;           // kNoteOn, kNoteOff or kNotePressure
+    uint8_t lane;
+    uint8_t note;
+    uint8_t value;          // Velocity or pressure
+};
+
+struct EventQueue {
+    QueuedEvent events[EVENT_QUEUE_SIZE];
+    std::atomic<uint32_t> head{0};      // Written by the producer only
+    std::atomic<uint32_t> tail{0};      // Written by the consumer only
+
+    // Producer: false when full (the event is dropped)
+    bool push(const QueuedEvent& e) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) >= EVENT_QUEUE_SIZE) return false;
+        events[h & (EVENT_QUEUE_SIZE - 1)] = e;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer: oldest event, or nullptr when empty
+    const QueuedEvent* peek() const {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire)) return nullptr;
+        return &events[t & (EVENT_QUEUE_SIZE - 1)];
+    }
+
+    void pop() {
+        tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+};
+
+// CPU governor: block cost is measured with the core cycle counter on the module
+// and with a steady clock on the computer (bench builds). The plugin never
+// writes the debug registers (that faults in unprivileged code): it only
+// uses the cycle counter when the firmware has already enabled it, and the
+// governor stays off otherwise. The tick rate on the module is the assumed
+// core clock (see README), overridable with -DGOVERNOR_TICKS_PER_SECOND.
+#if HANDPAN_DEVICE_BUILD
+#ifndef GOVERNOR_TICKS_PER_SECOND
+#define GOVERNOR_TICKS_PER_SECOND 600000000.0f          // Assumed Cortex-M7 core clock (600 MHz)
+#endif
+static inline uint32_t governorTicks() { return *(volatile uint32_t*)0xE0001004; }     // DWT_CYCCNT
+static inline bool governorClockAvailable() {
+    return (*(volatile uint32_t*)0xE000EDFC & (1u << 24))          // DEMCR.TRCENA: DWT enabled
+        && (*(volatile uint32_t*)0xE0001000 & 1u);                  // DWT_CTRL.CYCCNTENA: counter running
+}
+#else
+#define GOVERNOR_TICKS_PER_SECOND 1000000000.0f
+static inline uint32_t governorTicks() {
+    return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+static inline bool governorClockAvailable() { return true; }
+#endif
+
+#define GOVERNOR_MIN_MODES 2                            // Never shed below the fundamental and one partial
+#define GOVERNOR_HOLD_BLOCKS 4                          // Blocks to wait after a change before the next one
+#define GOVERNOR_STUCK_BLOCKS 8                         // Blocks measured as free before the clock counts as stopped
+
+// Sheds the quietest modes of every voice, then the oldest voices, while the
+// measured load is over budget, and gives them back once it falls well below.
+struct Governor {
+    float load = 0.0f;          // Smoothed share of the block time spent in step()
+    int modeCap = MAX_MODES;    // Modes per voice allowed right now
+    int voiceCap = MAX_VOICES;  // Voices allowed right now
+    int hold = 0;
+    int stuckBlocks = 0;        // Consecutive blocks that took no ticks
+    bool clockAvailable = false; // Cycle counter enabled by the firmware (set on construct)
+
+    // A block never takes zero time, so a clock that does not move is not running
+    bool clockRunning() const { return clockAvailable && stuckBlocks < GOVERNOR_STUCK_BLOCKS; }
+
+    void update(uint32_t ticks, int numFrames, float budget, int maxModes, int numVoices) {
+        if (ticks == 0) { if (stuckBlocks < GOVERNOR_STUCK_BLOCKS) ++stuckBlocks; }
+        else stuckBlocks = 0;
+        float blockTicks = GOVERNOR_TICKS_PER_SECOND * numFrames / (float)SAMPLE_RATE;
+        float cost = ticks / blockTicks;
+        load += ((cost > load) ? 0.5f : 0.05f) * (cost - load);     // Rise fast, fall slowly
+        if (budget <= 0.0f || !clockRunning()) {
+            modeCap = maxModes;
+            voiceCap = numVoices;
+            return;
+        }
+        if (modeCap > maxModes) modeCap = maxModes;
+        if (voiceCap > numVoices) voiceCap = numVoices;
+        if (hold > 0) { --hold; return; }
+        if (load > budget) {
+            if (modeCap > GOVERNOR_MIN_MODES) { --modeCap; hold = GOVERNOR_HOLD_BLOCKS; }
+            else if (voiceCap > 1) { --voiceCap; hold = GOVERNOR_HOLD_BLOCKS; }
+        } else if (load < 0.75f * budget) {
+            if (voiceCap < numVoices) { ++voiceCap; hold = GOVERNOR_HOLD_BLOCKS; }
+            else if (modeCap < maxModes) { ++modeCap; hold = GOVERNOR_HOLD_BLOCKS; }
+        }
+    }
+};
+
+// ModalConfig: defines the modal structure for each instrument
+struct ModalConfig {
+    float ratios[MAX_MODES];
+    float gains[MAX_MODES];
+    int count;
+};
+
+// Values derived from the parameters. parameterChanged() refreshes them (and
+// step() does on a sample rate change), the audio path only reads them.
+struct DerivedParams {
+    uint32_t sampleRate = 0;        // Rate they were derived for (0 = not yet)
+    float baseHz;                   // Base Freq
+    float decayMs;                  // Decay
+    int instrType;
+    int excType;
+    int excitAttack;
+    int excitRelease;
+    int resType;                    // Clamped to the resonator kernels
+    int noiseType;                  // Clamped to the noise kernels
+    float noiseLevel;               // 0..1
+    float noiseA, noiseD, noiseR;   // Noise ADSR times in samples
+    float noiseS;                   // Noise sustain level
+    bool analyticStrike;
+    float cpuBudget;                // 0..1, 0 = governor off
+    float handWidth;                // 0..1, pan of the outer lanes away from the centre
+    float modeSpread;               // 0..1, pan of the partials around their lane
+    bool noteOffDamp;               // MIDI note-off / aftertouch damp the note
+    bool restrike;                  // A strike on a ringing note re-excites its voice
+    int engine;                     // Resonator engine of new voices
+    bool glide;                     // Ringing voices follow the pitch of their lane (Rotation)
+    ModalConfig config;             // Modes of the instrument
+    float decayScale;               // Instrument specific decay stretch
+    float modeBandwidth[MAX_MODES]; // Bandwidth of each mode per 1/decay (spread and damping)
+    float lpAlpha;                  // Output lowpass coefficient
 };
 
 // Main algorithm structure
 struct ModalInstrument : _NT_algorithm {
-    Voice voices[NUM_VOICES];    // All voices
-    float lastTrigger1;          // Last trigger state
-    float lastTrigger2;          // Last trigger state
-    float lpState;               // Lowpass filter state for output
+    Voice* voices;               // All voices (numVoices, carved from the instance memory)
+    Voice* fadeVoices;           // Extra slots where stolen voices' tails fade out (VOICE_FADE_SLOTS)
+    float fadeGain[VOICE_FADE_SLOTS]; // Gain of each fading tail
+    int freeHead;                // First free voice, -1 when all are playing
+    int numActive;               // Voices playing
+    int numVoices;               // Polyphony (specification)
+    int maxModes;                // Modes per voice (specification)
+    int numLanes;                // Gate / pitch lanes (specification)
+    bool lastGate[MAX_LANES];    // Last gate state of each lane
+    float lastGateIn[MAX_LANES]; // Last gate input samples (sub-sample edge position)
+    _NT_parameterPages pageList; // Pages of this instance (the inputs depend on the lanes)
+    float lpState;               // Lowpass filter state for output (left)
+    float lpStateR;              // Lowpass filter state for output (right)
     Envelope noiseEnv;           // global Noise-ADSR
-    bool noiseGate;              // global Gate-Flag for Noise          
+    bool noiseGate = false;      // global Gate-Flag for Noise
+    ResonatorConstants resConst; // Resonator shaping constants for the current sample rate
+    NoiseState noise;            // Noise generator state
+    ControlRamp noiseLevel;      // Smoothed noise level
+    Rng rng;                     // Random source for the resonator start state
+    Governor governor;           // Load-dependent mode and voice caps
+    DerivedParams derived;       // Cached parameter maths
+    EventQueue queue;            // Timestamped note events (MIDI)
+    uint32_t sampleTime;         // Sample clock at the start of the next block
+    int midiHeld;                // MIDI notes held (opens the noise gate like the gate inputs)
+    int laneVoice[MAX_LANES];    // Newest gate-played voice of each lane (glide), -1 if none
+    float* scratch;              // Own scratch, used when the shared work buffer is too small
+    int scratchFloats;
 };
 
 // Parameters and enums
@@ -385,9 +1164,22 @@ enum {
     kParamNoiseSustain,
     kParamNoiseRelease,
     kParamExcitationAttack,
-    kParamExcitationRelease
+    kParamExcitationRelease,
+    kParamStrikeMode,
+    kParamCpuBudget,
+    kParamHandWidth,
+    kParamModeSpread,
+    kParamMidiChannel,
+    kParamNoteOffMode,
+    kParamRestrike,
+    kParamEngine,
+    kParamLaneInputs        // Trigger and Note CV of lanes 3 and up, in pairs
 };
 
+// Lanes 1 and 2 keep their original inputs, the others follow the fixed parameters
+static int laneGateParam(int lane) { return (lane < 2) ? kParamTrigger1 + lane : kParamLaneInputs + 2 * (lane - 2); }
+static int laneNoteParam(int lane) { return (lane < 2) ? kParamNoteCV1 + lane : kParamLaneInputs + 2 * (lane - 2) + 1; }
+
 static const char* instrumentTypes[] = {
     "Handpan", "Steel Drum", "Bell", "Gong", "Triangle", "Tabla", "Conga", "Tom", "Timpani", "Udu",
     "Slit Drum", "Organ Pipe", "Cowbell", "Frame Drum", "Kalimba", "Woodblock", "Glass Bowl", "Metal Pipe",
@@ -404,6 +1196,22 @@ static const char* excitationTypes[] = {
     "Muted Slap", "Brush", "Double Tap", "Reverse", "Noise Burst", "Triangle Pulse", "Sine Burst"
 };
 
+static const char* strikeModes[] = {
+    "Buffered", "Analytic"
+};
+
+static const char* restrikeModes[] = {
+    "New Voice", "Re-strike"
+};
+
+static const char* engineModes[] = {
+    "Biquad", "Rotation", "Rot. Glide"
+};
+
+static const char* noteOffModes[] = {
+    "Ignore", "Damp"
+};
+
 static const char* resonatorTypes[] = {
     "Standard", "Fast Decay", "Soft Clip", "Dyn Gain", "Env Damp", "Age Damp", "Asymmetry", "Env Gain",
     "Limiter", "Highpass", "Bright", "Env Clip", "Out Damp", "Phase Flip", "Even Harm", "Out Lim",
@@ -445,29 +1253,48 @@ static const _NT_parameter parameters[] = {
     { "Noise R", 1, 4000, 100, kNT_unitMs, kNT_scalingNone, nullptr },
     { "Exciter Attack", 1, 128, 16, kNT_unitFrames, kNT_scalingNone, nullptr },
     { "Exciter Release", 1, 256, 32, kNT_unitFrames, kNT_scalingNone, nullptr },
+    { "Strike", 0, 1, 0, kNT_unitEnum, kNT_scalingNone, strikeModes },
+    { "CPU Budget", 0, 100, 0, kNT_unitPercent, kNT_scalingNone, nullptr },  // 0 = governor off; no effect without the core cycle counter
+    { "Hand Width", 0, 100, 0, kNT_unitPercent, kNT_scalingNone, nullptr },  // Lane 1 left, the last lane right
+    { "Mode Spread", 0, 100, 0, kNT_unitPercent, kNT_scalingNone, nullptr }, // Partials spread around the lane
+    { "MIDI Ch", 0, 16, 1, kNT_unitNone, kNT_scalingNone, nullptr },          // Lane 1 on this channel, the others on the next ones, 0 = off
+    { "Note Off", 0, 1, 0, kNT_unitEnum, kNT_scalingNone, noteOffModes },     // Damp: note-off and aftertouch mute the note
+    { "Repeat", 0, 1, 0, kNT_unitEnum, kNT_scalingNone, restrikeModes },      // Re-strike: a ringing note takes the new strike
+    { "Engine", 0, 2, 0, kNT_unitEnum, kNT_scalingNone, engineModes },        // Rot. Glide: ringing notes follow the Note CV
 };
 
-static const uint8_t page1[] = { kParamTrigger1, kParamTrigger2, kParamNoteCV1, kParamNoteCV2, kParamBaseFreqCV, kParamDecayCV, kParamExcitationCV };
-static const uint8_t page2[] = { kParamOutputL, kParamOutputModeL, kParamOutputR, kParamOutputModeR };
-static const uint8_t page3[] = { kParamInstrumentType, kParamExcitationType, kParamExcitationAttack, kParamExcitationRelease, kParamDecay, kParamBaseFreq };
-static const uint8_t page4[] = { kParamResonatorType };
+// Inputs of lanes 3 and up, appended per instance (unassigned by default)
+static const _NT_parameter laneParameters[] = {
+    NT_PARAMETER_AUDIO_INPUT("Trigger", 0, 0)
+    NT_PARAMETER_CV_INPUT("Note CV", 0, 0)
+};
+
+static const char* laneGateNames[MAX_LANES - 2] = {
+    "Trigger 3", "Trigger 4", "Trigger 5", "Trigger 6", "Trigger 7", "Trigger 8"
+};
+
+static const char* laneNoteNames[MAX_LANES - 2] = {
+    "Note CV 3", "Note CV 4", "Note CV 5", "Note CV 6", "Note CV 7", "Note CV 8"
+};
+
+// Page 1 (CV Inputs) is built per instance: the triggers and note CVs of its
+// lanes, then the shared CV inputs
+static const uint8_t page1Shared[] = { kParamBaseFreqCV, kParamDecayCV, kParamExcitationCV };
+static const uint8_t page2[] = { kParamOutputL, kParamOutputModeL, kParamOutputR, kParamOutputModeR, kParamHandWidth, kParamModeSpread };
+static const uint8_t page3[] = { kParamInstrumentType, kParamExcitationType, kParamExcitationAttack, kParamExcitationRelease, kParamStrikeMode, kParamRestrike, kParamDecay, kParamBaseFreq };
+static const uint8_t page4[] = { kParamResonatorType, kParamEngine };
 static const uint8_t page5[] = { kParamNoiseType, kParamNoiseLevel, kParamNoiseAttack, kParamNoiseDecay, kParamNoiseSustain, kParamNoiseRelease };
+static const uint8_t page6[] = { kParamCpuBudget };
+static const uint8_t page7[] = { kParamMidiChannel, kParamNoteOffMode };
 
 static const _NT_parameterPage pages[] = {
-    { "CV Inputs", ARRAY_SIZE(page1), page1 },
+    { "CV Inputs", 0, nullptr },
     { "Outputs", ARRAY_SIZE(page2), page2 },
     { "Modal Synth", ARRAY_SIZE(page3), page3 },
     { "Resonator", ARRAY_SIZE(page4), page4 },
-    { "Noise", ARRAY_SIZE(page5), page5 }
-};
-
-static const _NT_parameterPages parameterPages = { ARRAY_SIZE(pages), pages };
-
-// ModalConfig: defines the modal structure for each instrument
-struct ModalConfig {
-    float ratios[MAX_MODES];
-    float gains[MAX_MODES];
-    int count;
+    { "Noise", ARRAY_SIZE(page5), page5 },
+    { "CPU", ARRAY_SIZE(page6), page6 },
+    { "MIDI", ARRAY_SIZE(page7), page7 }
 };
 
 // Returns the modal configuration for the selected instrument type
@@ -530,14 +1357,122 @@ ModalConfig getModalConfig(int type) {
     return config;
 }
 
+// Specifications
+enum {
+    kSpecVoices = 0,
+    kSpecModes,
+    kSpecLanes
+};
+
+static const _NT_specification specifications[] = {
+    { .name = "Voices", .min = MIN_VOICES, .max = MAX_VOICES, .def = DEFAULT_VOICES, .type = kNT_typeGeneric },
+    { .name = "Max modes", .min = 2, .max = MAX_MODES, .def = DEFAULT_MODES, .type = kNT_typeGeneric },
+    { .name = "Lanes", .min = 1, .max = MAX_LANES, .def = DEFAULT_LANES, .type = kNT_typeGeneric },
+};
+
+// Shortest run of frames the scratch must hold besides the block buffers
+#define SCRATCH_MIN_RUN 16
+
+// Memory layout of one instance, split by access pattern:
+//   SRAM: the algorithm itself (noise state, block-rate state), then its parameter table and pages
+//   DTC:  the voices (plus the fade slots) and their mode arrays, touched every sample
+// The excitation shapes and coefficient tables are shared by all instances and live in static DRAM.
+struct InstanceLayout {
+    int numVoices;
+    int maxModes;
+    int numLanes;
+    int numParameters;
+    uint32_t paramsOffset;                  // In SRAM, after the algorithm
+    uint32_t pagesOffset;
+    uint32_t inputPageOffset;
+    uint32_t scratchOffset;
+    int scratchFloats;
+    uint32_t sram;
+    uint32_t modesOffset;                   // In DTC, after the voices
+    uint32_t dtc;
+
+    explicit InstanceLayout(const int32_t* specs) {
+        numVoices = specs ? specs[kSpecVoices] : DEFAULT_VOICES;
+        maxModes  = specs ? specs[kSpecModes] : DEFAULT_MODES;
+        numLanes  = specs ? specs[kSpecLanes] : DEFAULT_LANES;
+        if (numVoices < MIN_VOICES) numVoices = MIN_VOICES;
+        if (numVoices > MAX_VOICES) numVoices = MAX_VOICES;
+        if (maxModes < 1) maxModes = 1;
+        if (maxModes > MAX_MODES) maxModes = MAX_MODES;
+        if (numLanes < 1) numLanes = 1;
+        if (numLanes > MAX_LANES) numLanes = MAX_LANES;
+        numParameters = (numLanes > 2) ? laneGateParam(numLanes) : kParamLaneInputs;
+        paramsOffset = align16(sizeof(ModalInstrument));
+        pagesOffset = align16(paramsOffset + numParameters * sizeof(_NT_parameter));
+        inputPageOffset = pagesOffset + sizeof(pages);
+        scratchOffset = align16(inputPageOffset + 2 * numLanes + ARRAY_SIZE(page1Shared));
+        scratchFloats = 2 * NT_globals.maxFramesPerStep + 3 * SCRATCH_MIN_RUN;
+        sram = scratchOffset + scratchFloats * sizeof(float);
+        modesOffset = align16((numVoices + VOICE_FADE_SLOTS) * sizeof(Voice));
+        dtc = modesOffset + (numVoices + VOICE_FADE_SLOTS) * ModalBank::memorySize(maxModes) * sizeof(float);
+    }
+
+    static uint32_t align16(uint32_t n) { return (n + 15) & ~15u; }
+};
+
 // Algorithm construct function
-_NT_algorithm* construct(const _NT_algorithmMemoryPtrs& ptrs, const _NT_algorithmRequirements& req, const int32_t*) {
+_NT_algorithm* construct(const _NT_algorithmMemoryPtrs& ptrs, const _NT_algorithmRequirements& req, const int32_t* specifications) {
+    InstanceLayout layout(specifications);
     ModalInstrument* self = new(ptrs.sram) ModalInstrument;
-    self->parameters = parameters;
-    self->parameterPages = &parameterPages;
-    self->lastTrigger1 = 0.0f;
-    self->lastTrigger2 = 0.0f;
+    self->numVoices = layout.numVoices;
+    self->maxModes = layout.maxModes;
+    self->voices = (Voice*)ptrs.dtc;
+    float* modeMem = (float*)(ptrs.dtc + layout.modesOffset);
+    for (int v = 0; v < self->numVoices + VOICE_FADE_SLOTS; ++v) {
+        new(&self->voices[v]) Voice;
+        self->voices[v].bank.attach(modeMem + v * ModalBank::memorySize(self->maxModes), self->maxModes);
+        self->voices[v].nextFree = (v + 1 < self->numVoices) ? v + 1 : -1;
+    }
+    self->fadeVoices = &self->voices[self->numVoices];
+    for (int i = 0; i < VOICE_FADE_SLOTS; ++i) self->fadeGain[i] = 0.0f;
+    self->freeHead = 0;
+    self->numActive = 0;
     self->lpState = 0.0f;
+    self->lpStateR = 0.0f;
+    self->numLanes = layout.numLanes;
+    for (int lane = 0; lane < MAX_LANES; ++lane) {
+        self->lastGate[lane] = false;
+        self->lastGateIn[lane] = 0.0f;
+    }
+
+    // Parameters: the fixed ones, then the inputs of lanes 3 and up
+    _NT_parameter* params = (_NT_parameter*)(ptrs.sram + layout.paramsOffset);
+    memcpy(params, parameters, sizeof(parameters));
+    for (int lane = 2; lane < layout.numLanes; ++lane) {
+        params[laneGateParam(lane)] = laneParameters[0];
+        params[laneGateParam(lane)].name = laneGateNames[lane - 2];
+        params[laneNoteParam(lane)] = laneParameters[1];
+        params[laneNoteParam(lane)].name = laneNoteNames[lane - 2];
+    }
+    uint8_t* inputPage = ptrs.sram + layout.inputPageOffset;
+    int numInputs = 0;
+    for (int lane = 0; lane < layout.numLanes; ++lane) inputPage[numInputs++] = laneGateParam(lane);
+    for (int lane = 0; lane < layout.numLanes; ++lane) inputPage[numInputs++] = laneNoteParam(lane);
+    for (int i = 0; i < (int)ARRAY_SIZE(page1Shared); ++i) inputPage[numInputs++] = page1Shared[i];
+    _NT_parameterPage* pageTable = (_NT_parameterPage*)(ptrs.sram + layout.pagesOffset);
+    memcpy(pageTable, pages, sizeof(pages));
+    pageTable[0].numParams = numInputs;
+    pageTable[0].params = inputPage;
+    self->pageList.numPages = ARRAY_SIZE(pages);
+    self->pageList.pages = pageTable;
+    self->parameters = params;
+    self->parameterPages = &self->pageList;
+    self->scratch = (float*)(ptrs.sram + layout.scratchOffset);
+    self->scratchFloats = layout.scratchFloats;
+    self->sampleTime = 0;
+    self->midiHeld = 0;
+    for (int lane = 0; lane < MAX_LANES; ++lane) self->laneVoice[lane] = -1;
+    self->resConst.update(SAMPLE_RATE);
+    self->noise = NoiseState();
+    self->rng.seed(1);
+    self->governor.modeCap = self->maxModes;
+    self->governor.voiceCap = self->numVoices;
+    self->governor.clockAvailable = governorClockAvailable();
     return self;
 }
 
@@ -571,511 +1506,864 @@ float computeADSR(Envelope& env, int attack, int decay, float sustain, int relea
     return env.env;
 }
 
+// Next sample of one noise type (the switch is resolved at compile time)
+template <int Type>
+inline float noiseSample(NoiseState& n) {
+    float noiseVal = 0.0f;
+
+    // Noise types
+    switch (Type) {
+        case 0: // White Noise
+            n.noiseSeed = 1664525 * n.noiseSeed + 1013904223;
+            noiseVal = ((n.noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
+            break;
+        case 1: // Pink Noise
+            n.noiseSeed = 1664525 * n.noiseSeed + 1013904223;
+            n.pink = 0.98f * n.pink + 0.02f * (((n.noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f);
+            noiseVal = n.pink;
+            break;
+        case 2: // Blue Noise
+            n.noiseSeed = 1664525 * n.noiseSeed + 1013904223;
+            {
+                float white = ((n.noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
+                noiseVal = white - n.blueLast;
+                n.blueLast = white;
+            }
+            break;
+        case 3: // Highpass Noise (fast)
+            n.noiseSeed = 1664525 * n.noiseSeed + 1013904223;
+            {
+                float white = ((n.noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
+                n.hp1 = 0.8f * n.hp1 + white - (0.8f * n.hp1);
+                noiseVal = n.hp1;
+            }
+            break;
+        case 4: // Highpass Noise (slow)
+            n.noiseSeed = 1664525 * n.noiseSeed + 1013904223;
+            {
+                float white = ((n.noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
+                n.hp2 = 0.95f * n.hp2 + white - (0.95f * n.hp2);
+                noiseVal = n.hp2;
+            }
+            break;
+        case 5: // Lowpass Noise (fast)
+            n.noiseSeed = 1664525 * n.noiseSeed + 1013904223;
+            {
+                float white = ((n.noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
+                n.lp1 = 0.85f * n.lp1 + 0.15f * white;
+                noiseVal = n.lp1;
+            }
+            break;
+        case 6: // Lowpass Noise (slow)
+            n.noiseSeed = 1664525 * n.noiseSeed + 1013904223;
+            {
+                float white = ((n.noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
+                n.lp2 = 0.98f * n.lp2 + 0.02f * white;
+                noiseVal = n.lp2;
+            }
+            break;
+        case 7: // Bitcrushed Noise (8 levels)
+            n.noiseSeed = 1664525 * n.noiseSeed + 1013904223;
+            {
+                float white = ((n.noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
+                noiseVal = floorf(white * 8.0f) / 8.0f;
+            }
+            break;
+        case 8: // Bitcrushed Noise (4 levels)
+            n.noiseSeed = 1664525 * n.noiseSeed + 1013904223;
+            {
+                float white = ((n.noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
+                noiseVal = floorf(white * 4.0f) / 4.0f;
+            }
+            break;
+        case 9: // Bitcrushed Noise (2 levels)
+            n.noiseSeed = 1664525 * n.noiseSeed + 1013904223;
+            {
+                float white = ((n.noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
+                noiseVal = (white > 0.0f) ? 1.0f : -1.0f;
+            }
+            break;
+        case 10: // Sample & Hold (fast)
+            if (++n.sAndHcnt1 > 10) {
+                n.noiseSeed = 1664525 * n.noiseSeed + 1013904223;
+                n.sAndH1 = ((n.noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
+                n.sAndHcnt1 = 0;
+            }
+            noiseVal = n.sAndH1;
+            break;
+        case 11: // Sample & Hold (medium)
+            if (++n.sAndHcnt2 > 40) {
+                n.noiseSeed = 1664525 * n.noiseSeed + 1013904223;
+                n.sAndH2 = ((n.noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
+                n.sAndHcnt2 = 0;
+            }
+            noiseVal = n.sAndH2;
+            break;
+        case 12: // Sample & Hold (slow)
+            if (++n.sAndHcnt3 > 200) {
+                n.noiseSeed = 1664525 * n.noiseSeed + 1013904223;
+                n.sAndH3 = ((n.noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
+                n.sAndHcnt3 = 0;
+            }
+            noiseVal = n.sAndH3;
+            break;
+        case 13: // Dust (rare)
+            n.noiseSeed = 1664525 * n.noiseSeed + 1013904223;
+            {
+                float white = ((n.noiseSeed >> 9) & 0xFFFF) / 32768.0f;
+                noiseVal = (white > 0.995f) ? (white * 2.0f - 1.0f) : 0.0f;
+            }
+            break;
+        case 14: // Dust (medium)
+            n.noiseSeed = 1664525 * n.noiseSeed + 1013904223;
+            {
+                float white = ((n.noiseSeed >> 9) & 0xFFFF) / 32768.0f;
+                noiseVal = (white > 0.98f) ? (white * 2.0f - 1.0f) : 0.0f;
+            }
+            break;
+        case 15: // Dust (frequent)
+            n.noiseSeed = 1664525 * n.noiseSeed + 1013904223;
+            {
+                float white = ((n.noiseSeed >> 9) & 0xFFFF) / 32768.0f;
+                noiseVal = (white > 0.90f) ? (white * 2.0f - 1.0f) : 0.0f;
+            }
+            break;
+        case 16: // Chopper (slow)
+            n.noiseSeed = 1664525 * n.noiseSeed + 1013904223;
+            {
+                float white = ((n.noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
+                n.chopperPhase1 += 0.005f;
+                if (n.chopperPhase1 > 2.0f * M_PI) n.chopperPhase1 -= 2.0f * M_PI;
+                noiseVal = white * (fastSin(n.chopperPhase1) > 0.0f ? 1.0f : 0.0f);
+            }
+            break;
+        case 17: // Chopper (medium)
+            n.noiseSeed = 1664525 * n.noiseSeed + 1013904223;
+            {
+                float white = ((n.noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
+                n.chopperPhase2 += 0.02f;
+                if (n.chopperPhase2 > 2.0f * M_PI) n.chopperPhase2 -= 2.0f * M_PI;
+                noiseVal = white * (fastSin(n.chopperPhase2) > 0.0f ? 1.0f : 0.0f);
+            }
+            break;
+        case 18: // Chopper (fast)
+            n.noiseSeed = 1664525 * n.noiseSeed + 1013904223;
+            {
+                float white = ((n.noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
+                n.chopperPhase3 += 0.08f;
+                if (n.chopperPhase3 > 2.0f * M_PI) n.chopperPhase3 -= 2.0f * M_PI;
+                noiseVal = white * (fastSin(n.chopperPhase3) > 0.0f ? 1.0f : 0.0f);
+            }
+            break;
+        case 19: // Metallic (xor-shift)
+            n.noiseSeed = 1664525 * n.noiseSeed + 1013904223;
+            {
+                uint32_t x = n.noiseSeed;
+                x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+                noiseVal = ((x & 0xFF) / 128.0f) - 1.0f;
+            }
+            break;
+        case 20: // AM Noise (slow)
+            n.noiseSeed = 1664525 * n.noiseSeed + 1013904223;
+            {
+                float white = ((n.noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
+                n.amPhase1 += 0.01f;
+                if (n.amPhase1 > 2.0f * M_PI) n.amPhase1 -= 2.0f * M_PI;
+                noiseVal = white * (0.5f + 0.5f * fastSin(n.amPhase1));
+            }
+            break;
+        case 21: // AM Noise (fast)
+            n.noiseSeed = 1664525 * n.noiseSeed + 1013904223;
+            {
+                float white = ((n.noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
+                n.amPhase2 += 0.05f;
+                if (n.amPhase2 > 2.0f * M_PI) n.amPhase2 -= 2.0f * M_PI;
+                noiseVal = white * (0.5f + 0.5f * fastSin(n.amPhase2));
+            }
+            break;
+        case 22: // Ringmod Noise (slow)
+        {
+            float white = ((n.noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
+            n.ringPhase1 += 0.01f;
+            if (n.ringPhase1 > 2.0f * M_PI) n.ringPhase1 -= 2.0f * M_PI;
+            noiseVal = white * fastSin(n.ringPhase1);
+        }
+        break;
+        case 23: // Ringmod Noise (fast)
+        n.noiseSeed = 1664525 * n.noiseSeed + 1013904223;
+        {
+            float white = ((n.noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
+            n.ringPhase2 += 0.05f;
+            if (n.ringPhase2 > 2.0f * M_PI) n.ringPhase2 -= 2.0f * M_PI;
+            noiseVal = white * fastSin(n.ringPhase2);
+        }
+        break;
+        case 24: // Envelope-followed Noise (slow)
+        n.noiseSeed = 1664525 * n.noiseSeed + 1013904223;
+        {
+            float white = ((n.noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
+            n.envPhase1 += 0.005f;
+            if (n.envPhase1 > 2.0f * M_PI) n.envPhase1 -= 2.0f * M_PI;
+            noiseVal = white * fabsf(fastSin(n.envPhase1));
+        }
+        break;
+        case 25: // Envelope-followed Noise (fast)
+        n.noiseSeed = 1664525 * n.noiseSeed + 1013904223;
+        {
+            float white = ((n.noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
+            n.envPhase2 += 0.03f;
+            if (n.envPhase2 > 2.0f * M_PI) n.envPhase2 -= 2.0f * M_PI;
+            noiseVal = white * fabsf(fastSin(n.envPhase2));
+        }
+        break;
+        case 26: // Blue+Pink Mix
+        n.noiseSeed = 1664525 * n.noiseSeed + 1013904223;
+        {
+            float white = ((n.noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
+            float blue = white - n.blueLast;
+            n.blueLast = white;
+            n.pink = 0.98f * n.pink + 0.02f * white;
+            noiseVal = 0.5f * blue + 0.5f * n.pink;
+        }
+        break;
+        case 27: // HP+LP Mix
+        n.noiseSeed = 1664525 * n.noiseSeed + 1013904223;
+        {
+            float white = ((n.noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
+            n.hp1 = 0.8f * n.hp1 + white - (0.8f * n.hp1);
+            n.lp1 = 0.85f * n.lp1 + 0.15f * white;
+            noiseVal = 0.5f * n.hp1 + 0.5f * n.lp1;
+        }
+        break;
+        case 28: // S&H + Bitcrush Mix
+        if (++n.sAndHcnt1 > 40) {
+            n.noiseSeed = 1664525 * n.noiseSeed + 1013904223;
+            n.sAndH1 = ((n.noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
+            n.sAndHcnt1 = 0;
+        }
+        {
+            float bc = floorf(n.sAndH1 * 4.0f) / 4.0f;
+            noiseVal = 0.5f * n.sAndH1 + 0.5f * bc;
+        }
+        break;
+        case 29: // White + Metallic Mix
+        n.noiseSeed = 1664525 * n.noiseSeed + 1013904223;
+        {
+            float white = ((n.noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
+            uint32_t x = n.noiseSeed;
+            x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+            float metallic = ((x & 0xFF) / 128.0f) - 1.0f;
+            noiseVal = 0.5f * white + 0.5f * metallic;
+        }
+        break;
+        default: // fallback to White Noise
+            n.noiseSeed = 1664525 * n.noiseSeed + 1013904223;
+            noiseVal = ((n.noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
+        break;
+        n.noiseSeed = 1664525 * n.noiseSeed + 1013904223;
+        }
+    return noiseVal;
+}
+
+// Render a block of one noise type
+template <int Type>
+void renderNoise(NoiseState& n, float* out, int count) {
+    for (int f = 0; f < count; ++f) out[f] = noiseSample<Type>(n);
+}
+
+// Dispatch table: one noise kernel per noise type, picked once per block
+typedef void (*NoiseKernel)(NoiseState&, float*, int);
+
+static const NoiseKernel noiseKernels[] = {
+    renderNoise<0>,  renderNoise<1>,  renderNoise<2>,  renderNoise<3>,  renderNoise<4>,
+    renderNoise<5>,  renderNoise<6>,  renderNoise<7>,  renderNoise<8>,  renderNoise<9>,
+    renderNoise<10>, renderNoise<11>, renderNoise<12>, renderNoise<13>, renderNoise<14>,
+    renderNoise<15>, renderNoise<16>, renderNoise<17>, renderNoise<18>, renderNoise<19>,
+    renderNoise<20>, renderNoise<21>, renderNoise<22>, renderNoise<23>, renderNoise<24>,
+    renderNoise<25>, renderNoise<26>, renderNoise<27>, renderNoise<28>, renderNoise<29>
+};
+
+// Block events: the gate edges found by the pre-pass and the queued events due in this block
+enum {
+    kEventTrigger = 0,      // Rising gate edge of a lane, or a MIDI note-on
+    kEventNoiseGate,        // Combined gate of all lanes changed
+    kEventDamp              // MIDI note-off or aftertouch
+};
+
+struct BlockEvent {
+    int frame;              // Frame offset in the block
+    int kind;               // kEventTrigger, kEventNoiseGate or kEventDamp
+    int value;              // Lane, new gate state for the noise gate
+    int note;               // MIDI note, -1 for the gate inputs
+    float amount;           // Velocity for triggers, damping for kEventDamp (0..1)
+    float delay;            // Triggers: sub-sample onset delay (0..1)
+};
+
+// Sub-sample position of a rising gate edge: the input crossed the threshold
+// at frame - 1 + delay, on the line between the two samples around it. The
+// excitation is delayed by that fraction (a hard 0 to 5V edge gives 0.1).
+static inline float gateEdgeDelay(float prev, float cur) {
+    float delay = (0.5f - prev) / (cur - prev);
+    return (delay > 0.0f) ? ((delay < 1.0f) ? delay : 1.0f) : 0.0f;
+}
+
+#define MAX_BLOCK_EVENTS 32
+
+// Frame of the block the oldest queued event plays at, numFrames when none is due in this block
+static int nextQueuedFrame(const EventQueue& queue, uint32_t blockStart, int numFrames) {
+    const QueuedEvent* qe = queue.peek();
+    if (!qe) return numFrames;
+    int32_t offset = (int32_t)(qe->time - blockStart);
+    if (offset < 0) return 0;
+    return (offset < numFrames) ? offset : numFrames;
+}
+
+// MIDI note playing Base Freq, and how far note-off / velocity reach
+#define MIDI_BASE_NOTE 60
+#define MIDI_DAMP_MAX 12.0f         // Bandwidth scale of a fully damped note
+#define MIDI_VELOCITY_TILT 0.7f     // Level lost by the top mode at velocity 0
+
+// Frequency ratio of a number of equal tempered semitones
+static float noteRatio(int semitones) {
+    static const float ratios[12] = {
+        1.0f, 1.05946309f, 1.12246205f, 1.18920712f, 1.25992105f, 1.33483985f,
+        1.41421356f, 1.49830708f, 1.58740105f, 1.68179283f, 1.78179744f, 1.88774863f
+    };
+    int octave = (semitones >= 0) ? semitones / 12 : -((11 - semitones) / 12);
+    return ratios[semitones - octave * 12] * fastExp2((float)octave);
+}
+
+// Pitch of a note on a lane at frame f: Base Freq, BaseFreq CV, then the
+// MIDI note, or the lane's Note CV for gate-played notes (note < 0)
+static float notePitch(const DerivedParams& d, const float* cvFreq, const float* cv, int note, int f) {
+    float baseHz = d.baseHz;
+    if (cvFreq && fabsf(cvFreq[f]) > 0.01f) {
+        baseHz = d.baseHz * fastExp2(cvFreq[f]);
+        baseHz = fmaxf(baseHz, 40.0f);
+    }
+    if (note >= 0) {
+        baseHz *= noteRatio(note - MIDI_BASE_NOTE);   // MIDI: exact equal temperament
+    } else if (cv && fabsf(cv[f]) < 6.0f) {
+        baseHz *= fastExp2(cv[f]);
+    }
+    return fmaxf(baseHz, 40.0f);
+}
+
+// Stereo position of a lane for Hand Width: the lanes spread evenly from
+// left to right, so two lanes put hand 1 on the left and hand 2 on the right
+static float lanePan(int lane, int numLanes, float width) {
+    return (numLanes > 1) ? width * (2.0f * lane / (numLanes - 1) - 1.0f) : 0.0f;
+}
+
+// Stereo position of each partial for Mode Spread: the fundamental stays on
+// its lane, the partials alternate sides like a pair of microphones would
+// pick up the different regions of a real pan
+static const float modeSpreadPos[MAX_MODES] = {
+    0.0f, -0.55f, 0.6f, -0.8f, 0.35f, 0.9f, -0.3f, -0.95f,
+    0.75f, -0.45f, 1.0f, -0.7f, 0.5f, -1.0f, 0.85f, -0.6f
+};
+
+// Refresh the derived parameters from the current values
+static void updateDerivedParams(ModalInstrument* self) {
+    DerivedParams& d = self->derived;
+    d.sampleRate   = SAMPLE_RATE;
+    d.baseHz       = self->v[kParamBaseFreq];
+    d.decayMs      = self->v[kParamDecay];
+    d.instrType    = self->v[kParamInstrumentType];
+    d.excType      = self->v[kParamExcitationType];
+    d.excitAttack  = self->v[kParamExcitationAttack];
+    d.excitRelease = self->v[kParamExcitationRelease];
+    d.resType      = self->v[kParamResonatorType];
+    if (d.resType < 0 || d.resType >= (int)ARRAY_SIZE(modalKernels[0][0])) d.resType = 0;
+    d.noiseType    = self->v[kParamNoiseType];
+    if (d.noiseType < 0 || d.noiseType >= (int)ARRAY_SIZE(noiseKernels)) d.noiseType = 0;
+    d.noiseLevel   = self->v[kParamNoiseLevel] / 100.0f;
+    d.noiseA       = (int)(self->v[kParamNoiseAttack] * SAMPLE_RATE / 1000.0f);
+    d.noiseD       = (int)(self->v[kParamNoiseDecay]  * SAMPLE_RATE / 1000.0f);
+    d.noiseR       = (int)(self->v[kParamNoiseRelease] * SAMPLE_RATE / 1000.0f);
+    d.noiseS       = self->v[kParamNoiseSustain] / 100.0f;
+    d.analyticStrike = (self->v[kParamStrikeMode] == 1);
+    d.cpuBudget    = self->v[kParamCpuBudget] / 100.0f;
+    d.handWidth    = self->v[kParamHandWidth] / 100.0f;
+    d.modeSpread   = self->v[kParamModeSpread] / 100.0f;
+    d.noteOffDamp  = (self->v[kParamNoteOffMode] == 1);
+    d.restrike     = (self->v[kParamRestrike] == 1);
+    d.engine       = (self->v[kParamEngine] == 0) ? kEngineBiquad : kEngineRotation;
+    d.glide        = (self->v[kParamEngine] == 2);
+
+    // Instrument: modes, decay stretch and per-mode bandwidth
+    d.config = getModalConfig(d.instrType);
+    float dampingFactor = 1.0f;
+    d.decayScale = 1.0f;
+    if (d.instrType == 3 || d.instrType == 4) dampingFactor = 0.7f;
+    else if (d.instrType == 8) d.decayScale = 2.5f;
+    else if (d.instrType == 13) d.decayScale = 2.0f;
+    for (int m = 0; m < d.config.count; ++m)
+        d.modeBandwidth[m] = (0.4f + 0.6f * m / d.config.count) * dampingFactor;
+
+    d.lpAlpha = fastExp(-2.0f * M_PI * 3000.0f / SAMPLE_RATE);
+    if (self->resConst.sampleRate != SAMPLE_RATE) self->resConst.update(SAMPLE_RATE);
+}
+
+// Voice allocation. Free voices are kept on a list, so a note costs nothing
+// to start while one is left; otherwise the quietest voice is stolen and its
+// tail moves to a fade slot (a swap of the bank headers) to fade out.
+
+// Move the sound of a voice to a fade slot: a free one, else the one closest
+// to silence (only cut when more tails than slots fade at the same time)
+static void fadeOutVoice(ModalInstrument* self, Voice& voice) {
+    int slot = 0;
+    for (int i = 0; i < VOICE_FADE_SLOTS; ++i) {
+        if (!self->fadeVoices[i].active) { slot = i; break; }
+        if (self->fadeGain[i] < self->fadeGain[slot]) slot = i;
+    }
+    Voice& fade = self->fadeVoices[slot];
+    ModalBank tail = fade.bank;
+    fade.bank = voice.bank;
+    voice.bank = tail;
+    fade.active = true;
+    self->fadeGain[slot] = 1.0f;
+}
+
+static void releaseVoice(ModalInstrument* self, int v) {
+    self->voices[v].active = false;
+    self->voices[v].nextFree = self->freeHead;
+    self->freeHead = v;
+    self->numActive--;
+}
+
+static int allocateVoice(ModalInstrument* self, int voiceCap) {
+    if (self->freeHead >= 0 && self->numActive < voiceCap) {
+        int v = self->freeHead;
+        self->freeHead = self->voices[v].nextFree;
+        self->numActive++;
+        return v;
+    }
+    int quietest = -1;
+    for (int v = 0; v < self->numVoices; ++v) {
+        const Voice& voice = self->voices[v];
+        if (voice.active && (quietest < 0 || voice.level < self->voices[quietest].level)) quietest = v;
+    }
+    fadeOutVoice(self, self->voices[quietest]);
+    return quietest;
+}
+
+// Re-strike: the active voice of this lane ringing at baseHz (within about 25 cents)
+// as the same instrument and resonator, -1 if none
+#define RESTRIKE_TOLERANCE 0.015f
+
+static int findRingingVoice(ModalInstrument* self, int lane, float baseHz, int instrType, int resType) {
+    for (int v = 0; v < self->numVoices; ++v) {
+        const Voice& voice = self->voices[v];
+        if (!voice.active || voice.lane != lane || voice.instrType != instrType || voice.bank.type != resType) continue;
+        if (fabsf(voice.baseHz - baseHz) < RESTRIKE_TOLERANCE * baseHz) return v;
+    }
+    return -1;
+}
+
 // Main audio processing loop
+// Two phases: a cheap pre-pass finds the gate edges of all lanes and their
+// frame offsets, then every active voice renders whole runs of frames between
+// those events into the output accumulator.
 extern "C" void step(_NT_algorithm* base, float* busFrames, int numFramesBy4) {
     ModalInstrument* self = static_cast<ModalInstrument*>(base);
     int numFrames = numFramesBy4 * 4;
-
- 
-    // Noise state variables (declare static at file or function scope)
-    static uint32_t noiseSeed = 1;
-    static float pink = 0.0f;
-    static float blueLast = 0.0f;
-    static float hp1 = 0.0f, hp2 = 0.0f;
-    static float lp1 = 0.0f, lp2 = 0.0f;
-    static int sAndHcnt1 = 0, sAndHcnt2 = 0, sAndHcnt3 = 0;
-    static float sAndH1 = 0.0f, sAndH2 = 0.0f, sAndH3 = 0.0f;
-    static float chopperPhase1 = 0.0f, chopperPhase2 = 0.0f, chopperPhase3 = 0.0f;
-    static float amPhase1 = 0.0f, amPhase2 = 0.0f;
-    static float ringPhase1 = 0.0f, ringPhase2 = 0.0f;
-    static float envPhase1 = 0.0f, envPhase2 = 0.0f;
-    // Input and output buffers
-    float* trig1   = busFrames + (self->v[kParamTrigger1] - 1) * numFrames;
-    float* trig2   = busFrames + (self->v[kParamTrigger2] - 1) * numFrames;
-    float* noteCV1 = (self->v[kParamNoteCV1] ? busFrames + (self->v[kParamNoteCV1] - 1) * numFrames : nullptr);
-    float* noteCV2 = (self->v[kParamNoteCV2] ? busFrames + (self->v[kParamNoteCV2] - 1) * numFrames : nullptr);
+    uint32_t startTicks = self->governor.clockAvailable ? governorTicks() : 0;
+
+    // Input and output buffers, a trigger and a note CV per lane (unassigned lanes never trigger)
+    int numLanes = self->numLanes;
+    const float* gateIn[MAX_LANES];
+    const float* noteCV[MAX_LANES];
+    float gateInEnd[MAX_LANES];
+    for (int lane = 0; lane < numLanes; ++lane) {
+        int gateBus = self->v[laneGateParam(lane)];
+        int noteBus = self->v[laneNoteParam(lane)];
+        gateIn[lane] = (gateBus ? busFrames + (gateBus - 1) * numFrames : nullptr);
+        noteCV[lane] = (noteBus ? busFrames + (noteBus - 1) * numFrames : nullptr);
+        gateInEnd[lane] = gateIn[lane] ? gateIn[lane][numFrames - 1] : 0.0f;   // Kept before the outputs can overwrite the inputs
+    }
     float* cvFreq  = (self->v[kParamBaseFreqCV] ? busFrames + (self->v[kParamBaseFreqCV] - 1) * numFrames : nullptr);
     float* cvDecay = (self->v[kParamDecayCV]    ? busFrames + (self->v[kParamDecayCV]    - 1) * numFrames : nullptr);
     float* cvExcit = (self->v[kParamExcitationCV] ? busFrames + (self->v[kParamExcitationCV] - 1) * numFrames : nullptr);
     float* outL = busFrames + (self->v[kParamOutputL] - 1) * numFrames;
     float* outR = busFrames + (self->v[kParamOutputR] - 1) * numFrames;
 
-    // UI parameters
-    float baseHzParam  = self->v[kParamBaseFreq];
-    float decayParam   = self->v[kParamDecay];
-    int instrType      = self->v[kParamInstrumentType];
-    int excTypeParam   = self->v[kParamExcitationType];
-    float noiseLevel   = self->v[kParamNoiseLevel] / 100.0f;
-    float noiseA       = (int)(self->v[kParamNoiseAttack] * SAMPLE_RATE / 1000.0f);
-    float noiseD       = (int)(self->v[kParamNoiseDecay]  * SAMPLE_RATE / 1000.0f);
-    float noiseR       = (int)(self->v[kParamNoiseRelease] * SAMPLE_RATE / 1000.0f);
-    float noiseS       = self->v[kParamNoiseSustain] / 100.0f;
-    int excitAttack    = self->v[kParamExcitationAttack];
-    int excitRelease   = self->v[kParamExcitationRelease];
-    int noiseType      = self->v[kParamNoiseType];
-
-    //Modal 
-    ModalConfig config = getModalConfig(instrType);
-
-//memset reset out buffers
-    memset(outL, 0, numFrames * sizeof(float));
-    memset(outR, 0, numFrames * sizeof(float));
-
-// Reset noise envelope
-    float gateState1 = self->lastTrigger1;
-    float gateState2 = self->lastTrigger2;
-
-    for (int f = 0; f < numFrames; ++f) {
-        // --- GATE-Handling ---
-        float currentGate1 = trig1[f];
-        float currentGate2 = trig2[f];
-        bool gateOn1 = (currentGate1 >= 0.5f);
-        bool gateOn2 = (currentGate2 >= 0.5f);
-
-
-        // --- HAND 1: Calculate base frequency ---
-        float baseHz1 = baseHzParam;
-        if (cvFreq && fabsf(cvFreq[f]) > 0.01f) {
-            baseHz1 = baseHzParam * powf(2.0f, cvFreq[f]);
-            baseHz1 = fmaxf(baseHz1, 40.0f);
-        }
-        float noteFactor1 = 1.0f;
-        if (noteCV1 && fabsf(noteCV1[f]) < 6.0f) {
-            float noteV = noteCV1[f];
-            noteFactor1 = powf(2.0f, noteV);
-        }
-        baseHz1 *= noteFactor1;
-        baseHz1 = fmaxf(baseHz1, 40.0f);
-
-        // --- HAND 2: Calculate base frequency ---
-        float baseHz2 = baseHzParam;
-        if (cvFreq && fabsf(cvFreq[f]) > 0.01f) {
-            baseHz2 = baseHzParam * powf(2.0f, cvFreq[f]); 
-            baseHz2 = fmaxf(baseHz2, 40.0f);
+    // Derived parameters (refreshed by parameterChanged)
+    if (self->derived.sampleRate != SAMPLE_RATE) updateDerivedParams(self);
+    const DerivedParams& d = self->derived;
+    const ModalConfig& config = d.config;
+    int resType = d.resType;        // For new voices, ringing ones keep the type they were struck with
+    ControlRamp& noiseLevel = self->noiseLevel;
+    noiseLevel.setTarget(d.noiseLevel, numFrames);
+    bool noiseOn = (noiseLevel.value > 0.0f || noiseLevel.inc != 0.0f);
+
+    // Governor caps from the last block: shed the quietest modes, then fade out the oldest voices
+    Governor& governor = self->governor;
+    if (d.cpuBudget > 0.0f) {
+        int active = 0;
+        for (int v = 0; v < self->numVoices; ++v) {
+            if (!self->voices[v].active) continue;
+            active++;
+            if (self->voices[v].bank.count > governor.modeCap) self->voices[v].bank.shed(governor.modeCap, (int)(VOICE_FADE_SECONDS * SAMPLE_RATE));
         }
-        float noteFactor2 = 1.0f;
-        if (noteCV2 && fabsf(noteCV2[f]) < 6.0f) {
-            float noteV = noteCV2[f];
-            noteFactor2 = powf(2.0f, noteV);
+        while (active > governor.voiceCap) {
+            int oldest = -1;
+            for (int v = 0; v < self->numVoices; ++v)
+                if (self->voices[v].active && (oldest < 0 || self->voices[v].age > self->voices[oldest].age)) oldest = v;
+            fadeOutVoice(self, self->voices[oldest]);     // Faded out like a stolen voice, not cut
+            releaseVoice(self, oldest);
+            active--;
         }
-        baseHz2 *= noteFactor2;
-        baseHz2 = fmaxf(baseHz2, 40.0f);
-
-        // --- Calculate decay ---
-        float decayCV = (cvDecay ? cvDecay[f] : 0.0f);
-        float decayMs = decayParam + decayCV * 8000.0f;
-        decayMs = fmaxf(decayMs, 100.0f);
-        float decay = decayMs / 1000.0f;
-
-        // --- Calculate excitation type ---
-        int excType = excTypeParam;
-        if (cvExcit && fabsf(cvExcit[f]) > 0.01f) {
-            excType = static_cast<int>(fminf(cvExcit[f] * 4.99f, 4.0f));
+    }
+
+    // Rot. Glide: the newest gate-played voice of each lane follows the pitch
+    // of its lane, retuned once per block from the first frame
+    if (d.glide) {
+        for (int lane = 0; lane < numLanes; ++lane) {
+            int v = self->laneVoice[lane];
+            if (v < 0) continue;
+            Voice& voice = self->voices[v];
+            if (!voice.active || voice.lane != lane || voice.note >= 0 || voice.bank.engine != kEngineRotation) continue;
+            float hz = notePitch(d, cvFreq, noteCV[lane], -1, 0);
+            if (fabsf(hz - voice.baseHz) > 0.0001f * hz) {
+                voice.bank.retune(hz / voice.baseHz);
+                voice.baseHz = hz;
+            }
         }
+    }
 
-        // --- GATE LOGIC FOR HAND 1 ---
-        if (!gateState1 && gateOn1) {
-            int voiceToUse = -1;
-            float maxAge = -1.0f;
-            for (int v = 0; v < NUM_VOICES; ++v) {
-                if (!self->voices[v].active) {
-                    voiceToUse = v;
-                    break;
-                } else if (self->voices[v].age > maxAge) {
-                    maxAge = self->voices[v].age;
-                    voiceToUse = v;
+    // Scratch: the block of noise and the right accumulator, then one run of
+    // frames of excitation and voice output (left and right). The shared work
+    // buffer normally; the instance's own when that is too small for a run.
+    // Runs are made as long as the scratch allows: the kernels load and store
+    // the mode state once per run, so 1-frame runs cost about 3x as much.
+    float* scratch    = NT_globals.workBuffer;
+    int scratchFloats = (int)(NT_globals.workBufferSizeBytes / sizeof(float));
+    if (scratchFloats < 2 * numFrames + 3 * SCRATCH_MIN_RUN) {
+        scratch = self->scratch;
+        scratchFloats = self->scratchFloats;
+    }
+    float* noiseBuf  = scratch;
+    float* accR      = noiseBuf + numFrames;
+    float* excBuf    = accR + numFrames;
+    int runFrames    = (scratchFloats - 2 * numFrames) / 3;
+    if (runFrames < 1) runFrames = 1;
+    float* voiceBufL = excBuf + runFrames;
+    float* voiceBufR = voiceBufL + runFrames;
+
+    // Noise engine: one block of the selected noise type, independent of the voice count
+    if (noiseOn) noiseKernels[d.noiseType](self->noise, noiseBuf, numFrames);
+    else memset(noiseBuf, 0, numFrames * sizeof(float));
+
+    // outL and accR are the block accumulators
+    memset(outL, 0, numFrames * sizeof(float));
+    memset(accR, 0, numFrames * sizeof(float));
+
+    bool gateState[MAX_LANES];
+    for (int lane = 0; lane < numLanes; ++lane) gateState[lane] = self->lastGate[lane];
+    bool noiseGateScan = self->noiseGate;
+    uint32_t blockStart = self->sampleTime;
+    float fadeStep = 1.0f / (VOICE_FADE_SECONDS * SAMPLE_RATE);
+    int queuedAt = nextQueuedFrame(self->queue, blockStart, numFrames);
+
+    int frame = 0;
+    while (frame < numFrames) {
+        // --- Phase 1: gate pre-pass, merged with the queued events ---
+        BlockEvent events[MAX_BLOCK_EVENTS];
+        int numEvents = 0;
+        int scanEnd = frame;
+        int eventRoom = MAX_BLOCK_EVENTS - (numLanes + 2);     // A trigger per lane and the noise gate fit after it
+        for (; scanEnd < numFrames && numEvents <= eventRoom; ++scanEnd) {
+            // Queued events due at this frame (late ones play at the first frame)
+            while (queuedAt <= scanEnd && numEvents <= eventRoom) {
+                const QueuedEvent& qe = *self->queue.peek();
+                if (qe.kind == kNoteOn) {
+                    events[numEvents++] = { scanEnd, kEventTrigger, qe.lane, qe.note, qe.value / 127.0f, 0.0f };
+                    self->midiHeld++;
+                } else {
+                    if (qe.kind == kNoteOff && self->midiHeld > 0) self->midiHeld--;
+                    if (d.noteOffDamp)
+                        events[numEvents++] = { scanEnd, kEventDamp, qe.lane, qe.note, (qe.kind == kNoteOff) ? 1.0f : qe.value / 127.0f, 0.0f };
                 }
+                self->queue.pop();
+                queuedAt = nextQueuedFrame(self->queue, blockStart, numFrames);
             }
-            Voice& voice = self->voices[voiceToUse];
-            voice.excitation.generate(excType, instrType, noiseLevel, noiseA, noiseD, noiseS, noiseR);
-            voice.excitationAR.trigger(excitAttack, excitRelease);
-            
+            bool anyGate = (self->midiHeld > 0);
+
+            for (int lane = 0; lane < numLanes; ++lane) {
+                const float* gate = gateIn[lane];
+                if (!gate) continue;
+                bool gateOn = (gate[scanEnd] >= 0.5f);
+                if (!gateState[lane] && gateOn) {
+                    float prev = scanEnd ? gate[scanEnd - 1] : self->lastGateIn[lane];
+                    events[numEvents++] = { scanEnd, kEventTrigger, lane, -1, 1.0f, gateEdgeDelay(prev, gate[scanEnd]) };
+                }
+                gateState[lane] = gateOn;
+                anyGate = anyGate || gateOn;
+            }
+            if (anyGate != noiseGateScan) {
+                noiseGateScan = anyGate;
+                events[numEvents++] = { scanEnd, kEventNoiseGate, noiseGateScan, -1, 0.0f, 0.0f };
+            }
+        }
 
-            float dampingFactor = 1.0f;
-            if (instrType == 3 || instrType == 4) dampingFactor = 0.7f;
-            else if (instrType == 8) decay *= 2.5f;
-            else if (instrType == 13) decay *= 2.0f;
+        // --- Phase 2: render the runs between events ---
+        for (int e = 0; e <= numEvents; ++e) {
+            int segEnd = (e < numEvents) ? events[e].frame : scanEnd;
+
+            while (frame < segEnd) {
+                int n = segEnd - frame;
+                if (n > runFrames) n = runFrames;
+
+                for (int v = 0; v < self->numVoices; ++v) {
+                    Voice& voice = self->voices[v];
+                    if (!voice.active) continue;
+                    bool driven = (voice.excitation.pos < voice.excitation.length);
+                    if (driven) {
+                        for (int f = 0; f < n; ++f)
+                            excBuf[f] = voice.excitation.next() * voice.excitationAR.next() * voice.strikeGain; // Get excitation signal for this voice
+                        voice.level = modalKernels[voice.bank.engine][1][voice.bank.type](voice.bank, excBuf, voiceBufL, voiceBufR, n, self->resConst);
+                        if (voice.excitation.pos >= voice.excitation.length) voice.bank.estimateLifetimes(voice.bank.type, self->resConst);
+                    } else {
+                        voice.level = modalKernels[voice.bank.engine][0][voice.bank.type](voice.bank, nullptr, voiceBufL, voiceBufR, n, self->resConst);
+                    }
 
-            
-           
+                    float* mixL = outL + frame;
+                    float* mixR = accR + frame;
+                    for (int f = 0; f < n; ++f) {
+                        mixL[f] += voiceBufL[f];
+                        mixR[f] += voiceBufR[f];
+                    }
+                    voice.age += n / (float)SAMPLE_RATE;
 
-            // Initialize modal resonators for this voice
-            for (int m = 0; m < config.count; ++m) {
-                float freq = baseHz1 * config.ratios[m];
-                freq = fminf(freq, SAMPLE_RATE * 0.35f);
-                float gain = config.gains[m];
-                float bw = (1.0f / decay) * (0.4f + 0.6f * m / config.count) * dampingFactor;
-                voice.modes[m].init(freq, gain, bw, self->v[kParamResonatorType]);
+                    // Drop the modes that have faded out, the voice ends with its last mode
+                    if (!driven) {
+                        voice.bank.cull(n);
+                        if (voice.bank.count == 0) releaseVoice(self, v);
+                    }
+                }
+
+                // Tails of stolen voices, faded out instead of cut
+                for (int i = 0; i < VOICE_FADE_SLOTS; ++i) {
+                    Voice& fade = self->fadeVoices[i];
+                    if (!fade.active) continue;
+                    modalKernels[fade.bank.engine][0][fade.bank.type](fade.bank, nullptr, voiceBufL, voiceBufR, n, self->resConst);
+                    float* mixL = outL + frame;
+                    float* mixR = accR + frame;
+                    float gain = self->fadeGain[i];
+                    for (int f = 0; f < n && gain > 0.0f; ++f) {
+                        mixL[f] += voiceBufL[f] * gain;
+                        mixR[f] += voiceBufR[f] * gain;
+                        gain -= fadeStep;
+                    }
+                    self->fadeGain[i] = gain;
+                    if (gain <= 0.0f) fade.active = false;
+                }
+
+                // Mix the noise once, with its envelope, in the centre
+                float* mixL = outL + frame;
+                float* mixR = accR + frame;
+                const float* noise = noiseBuf + frame;
+                for (int f = 0; f < n; ++f) {
+                    // Apply noise envelope                
+                    float noiseEnv = computeADSR(self->noiseEnv, d.noiseA, d.noiseD, d.noiseS, d.noiseR, self->noiseGate);
+                    float noiseVal = noise[f] * noiseEnv * noiseLevel.next();
+                    mixL[f] += noiseVal;
+                    mixR[f] += noiseVal;
+                }
+                frame += n;
             }
-            voice.active = true;
-            voice.age = 0.0f;
-        }
-        gateState1 = gateOn1;
-
-
-        // --- GATE LOGIC FOR HAND 2 ---
-        if (!gateState2 && gateOn2) {
-            int voiceToUse = -1;
-            float maxAge = -1.0f;
-            for (int v = 0; v < NUM_VOICES; ++v) {
-                if (!self->voices[v].active) {
-                    voiceToUse = v;
-                    break;
-                } else if (self->voices[v].age > maxAge) {
-                    maxAge = self->voices[v].age;
-                    voiceToUse = v;
+            if (e == numEvents) break;
+
+            // --- Handle the event ---
+            const BlockEvent& ev = events[e];
+            int f = ev.frame;
+            if (ev.kind == kEventNoiseGate) {
+                // NOISE-ADSR retrigger: at each Gate-On from any lane
+                if (ev.value && !self->noiseGate) {
+                    self->noiseEnv.stage = 1; // Attack
+                    self->noiseEnv.pos = 0;
+                    self->noiseEnv.env = 0.0f;
                 }
+                self->noiseGate = ev.value;
+                continue;
+            }
+            if (ev.kind == kEventDamp) {
+                // Note-off damps fully, aftertouch by its pressure: a hand resting on the note
+                float damping = 1.0f + (MIDI_DAMP_MAX - 1.0f) * ev.amount;
+                for (int v = 0; v < self->numVoices; ++v) {
+                    Voice& voice = self->voices[v];
+                    if (!voice.active || voice.note != ev.note || voice.lane != ev.value) continue;
+                    voice.bank.damp(damping / voice.damping);
+                    voice.damping = damping;
+                    if (voice.excitation.pos >= voice.excitation.length) voice.bank.estimateLifetimes(voice.bank.type, self->resConst);
+                }
+                continue;
             }
-            Voice& voice = self->voices[voiceToUse];
-            voice.excitation.generate(excType, instrType, noiseLevel, noiseA, noiseD, noiseS, noiseR);
-            voice.excitationAR.trigger(excitAttack, excitRelease);
-            
 
-            float dampingFactor = 1.0f;
-            if (instrType == 3 || instrType == 4) dampingFactor = 0.7f;
-            else if (instrType == 8) decay *= 2.5f;
-            else if (instrType == 13) decay *= 2.0f;
+            // --- Calculate base frequency for this lane (only at the trigger frame) ---
+            float baseHz = notePitch(d, cvFreq, noteCV[ev.value], ev.note, f);
 
-            
+            // --- Calculate decay ---
+            float decayCV = (cvDecay ? cvDecay[f] : 0.0f);
+            float decayMs = d.decayMs + decayCV * 8000.0f;
+            decayMs = fmaxf(decayMs, 100.0f);
+            float decay = decayMs / 1000.0f;
+
+            // --- Calculate excitation type ---
+            int excType = d.excType;
+            if (cvExcit && fabsf(cvExcit[f]) > 0.01f) {
+                excType = static_cast<int>(fminf(cvExcit[f] * 4.99f, 4.0f));
+            }
 
-            for (int m = 0; m < config.count; ++m) {
-                float freq = baseHz2 * config.ratios[m];
+            // --- Voice: the ringing one on re-strike, else a free voice, else steal the quietest ---
+            int voiceToUse = d.restrike ? findRingingVoice(self, ev.value, baseHz, d.instrType, resType) : -1;
+            bool restrike = (voiceToUse >= 0);
+            if (!restrike) voiceToUse = allocateVoice(self, governor.voiceCap);
+            Voice& voice = self->voices[voiceToUse];
+            voice.excitation.start(excType, d.instrType, ev.delay);
+            voice.excitationAR.trigger(d.excitAttack, d.excitRelease);
+            voice.lane = ev.value;
+            voice.note = ev.note;
+            voice.strikeGain = ev.amount;
+            decay *= d.decayScale;
+
+            // Initialize modal resonators for this voice, placed around its lane.
+            // The voice keeps its mode count, resonator type and bandwidths until
+            // it ends, so changing the instrument never touches ringing voices.
+            // On re-strike the ringing modes keep their state and take the new
+            // excitation on top; modes that had died out are brought back.
+            float pan = lanePan(ev.value, numLanes, d.handWidth);
+            int modeCount = (config.count < governor.modeCap) ? config.count : governor.modeCap;
+            if (restrike) {
+                if (voice.damping != 1.0f) voice.bank.damp(1.0f / voice.damping);
+                voice.bank.rearm();
+            } else {
+                voice.bank.setCount(modeCount);
+                voice.bank.type = resType;
+                voice.bank.engine = modalEngine(d.engine, resType);
+                voice.baseHz = baseHz;
+                voice.instrType = d.instrType;
+            }
+            voice.damping = 1.0f;
+            for (int m = 0; m < modeCount; ++m) {
+                float freq = voice.baseHz * config.ratios[m];     // On re-strike the pitch the voice rings at
                 freq = fminf(freq, SAMPLE_RATE * 0.35f);
                 float gain = config.gains[m];
-                float bw = (1.0f / decay) * (0.4f + 0.6f * m / config.count) * dampingFactor;
-                voice.modes[m].init(freq, gain, bw, self->v[kParamResonatorType]);
+                if (ev.amount < 1.0f) gain *= 1.0f - (1.0f - ev.amount) * MIDI_VELOCITY_TILT * m / config.count; // Softer is darker
+                int slot = m;
+                if (restrike) {
+                    slot = voice.bank.findMode(freq, RESTRIKE_TOLERANCE);
+                    if (slot >= 0) { voice.bank.setGain(slot, gain); continue; }
+                    slot = voice.bank.add();
+                    if (slot < 0) continue;
+                }
+                float bw = (1.0f / decay) * d.modeBandwidth[m];
+                voice.bank.init(slot, freq, gain, bw, resType, self->rng);
+                voice.bank.setPan(slot, pan + d.modeSpread * modeSpreadPos[m]);
+            }
+
+            // Analytic strike: apply the whole excitation now as initial state.
+            // Only the linear part of the resonator shaping (Phase Flip) applies to it.
+            if (d.analyticStrike) {
+                float strikeBuf[EXCITATION_MAX_LENGTH + 2];     // + the fractional delay taps
+                int len = voice.excitation.length;
+                for (int i = 0; i < len; ++i) {
+                    strikeBuf[i] = voice.excitation.next() * voice.excitationAR.next() * voice.strikeGain;
+                    if (resType == 13) strikeBuf[i] = -strikeBuf[i];
+                }
+                voice.bank.strike(strikeBuf, len);
+                voice.bank.estimateLifetimes(resType, self->resConst);
             }
             voice.active = true;
             voice.age = 0.0f;
+            voice.level = 1e30f;        // Not stolen before its first run is measured
+            if (ev.note < 0) self->laneVoice[ev.value] = voiceToUse;
         }
-        gateState2 = gateOn2;
-
-        // --- NOISE-ADSR retrigger: at each Gate-On from Trigger 1 or 2 ---
-        bool retriggerNoise = (!self->noiseGate && (gateOn1 || gateOn2));
-        self->noiseGate = (gateOn1 || gateOn2);
-        if (retriggerNoise) {
-            self->noiseEnv.stage = 1; // Attack
-            self->noiseEnv.pos = 0;
-            self->noiseEnv.env = 0.0f;
-        }
+    }
 
-        
+    // Output lowpass filter for smoothing, write output (attenuated)
+    float alpha = d.lpAlpha;
+    float lp = self->lpState;
+    float lpR = self->lpStateR;
+    for (int f = 0; f < numFrames; ++f) {
+        lp = lp + alpha * (outL[f] - lp);
+        lpR = lpR + alpha * (accR[f] - lpR);
+        outL[f] = lp * 0.1f;
+        outR[f] = lpR * 0.1f;
+    }
+    self->lpState = lp;
+    self->lpStateR = lpR;
 
-        // === Process all voices and sum output ===
-       float sample = 0.0f;
-        for (int v = 0; v < NUM_VOICES; ++v) {
-            if (!self->voices[v].active) continue;
-            float exc = self->voices[v].excitation.next() * self->voices[v].excitationAR.next(); // Get excitation signal for this voice
-            float sum = 0.0f;
-            bool silent = true;
-            for (int m = 0; m < config.count; ++m) {
-                float s = self->voices[v].modes[m].process(exc, self->v[kParamResonatorType]);
-                sum += s;
-                if (fabsf(s) > 0.0005f) silent = false;
-            }
-          
-            //Noise processing
-            float noiseVal = 0.0f;
-
-            // Noise types
-            switch (noiseType) {
-                case 0: // White Noise
-                    noiseSeed = 1664525 * noiseSeed + 1013904223;
-                    noiseVal = ((noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
-                    break;
-                case 1: // Pink Noise
-                    noiseSeed = 1664525 * noiseSeed + 1013904223;
-                    pink = 0.98f * pink + 0.02f * (((noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f);
-                    noiseVal = pink;
-                    break;
-                case 2: // Blue Noise
-                    noiseSeed = 1664525 * noiseSeed + 1013904223;
-                    {
-                        float white = ((noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
-                        noiseVal = white - blueLast;
-                        blueLast = white;
-                    }
-                    break;
-                case 3: // Highpass Noise (fast)
-                    noiseSeed = 1664525 * noiseSeed + 1013904223;
-                    {
-                        float white = ((noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
-                        hp1 = 0.8f * hp1 + white - (0.8f * hp1);
-                        noiseVal = hp1;
-                    }
-                    break;
-                case 4: // Highpass Noise (slow)
-                    noiseSeed = 1664525 * noiseSeed + 1013904223;
-                    {
-                        float white = ((noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
-                        hp2 = 0.95f * hp2 + white - (0.95f * hp2);
-                        noiseVal = hp2;
-                    }
-                    break;
-                case 5: // Lowpass Noise (fast)
-                    noiseSeed = 1664525 * noiseSeed + 1013904223;
-                    {
-                        float white = ((noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
-                        lp1 = 0.85f * lp1 + 0.15f * white;
-                        noiseVal = lp1;
-                    }
-                    break;
-                case 6: // Lowpass Noise (slow)
-                    noiseSeed = 1664525 * noiseSeed + 1013904223;
-                    {
-                        float white = ((noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
-                        lp2 = 0.98f * lp2 + 0.02f * white;
-                        noiseVal = lp2;
-                    }
-                    break;
-                case 7: // Bitcrushed Noise (8 levels)
-                    noiseSeed = 1664525 * noiseSeed + 1013904223;
-                    {
-                        float white = ((noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
-                        noiseVal = floorf(white * 8.0f) / 8.0f;
-                    }
-                    break;
-                case 8: // Bitcrushed Noise (4 levels)
-                    noiseSeed = 1664525 * noiseSeed + 1013904223;
-                    {
-                        float white = ((noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
-                        noiseVal = floorf(white * 4.0f) / 4.0f;
-                    }
-                    break;
-                case 9: // Bitcrushed Noise (2 levels)
-                    noiseSeed = 1664525 * noiseSeed + 1013904223;
-                    {
-                        float white = ((noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
-                        noiseVal = (white > 0.0f) ? 1.0f : -1.0f;
-                    }
-                    break;
-                case 10: // Sample & Hold (fast)
-                    if (++sAndHcnt1 > 10) {
-                        noiseSeed = 1664525 * noiseSeed + 1013904223;
-                        sAndH1 = ((noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
-                        sAndHcnt1 = 0;
-                    }
-                    noiseVal = sAndH1;
-                    break;
-                case 11: // Sample & Hold (medium)
-                    if (++sAndHcnt2 > 40) {
-                        noiseSeed = 1664525 * noiseSeed + 1013904223;
-                        sAndH2 = ((noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
-                        sAndHcnt2 = 0;
-                    }
-                    noiseVal = sAndH2;
-                    break;
-                case 12: // Sample & Hold (slow)
-                    if (++sAndHcnt3 > 200) {
-                        noiseSeed = 1664525 * noiseSeed + 1013904223;
-                        sAndH3 = ((noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
-                        sAndHcnt3 = 0;
-                    }
-                    noiseVal = sAndH3;
-                    break;
-                case 13: // Dust (rare)
-                    noiseSeed = 1664525 * noiseSeed + 1013904223;
-                    {
-                        float white = ((noiseSeed >> 9) & 0xFFFF) / 32768.0f;
-                        noiseVal = (white > 0.995f) ? (white * 2.0f - 1.0f) : 0.0f;
-                    }
-                    break;
-                case 14: // Dust (medium)
-                    noiseSeed = 1664525 * noiseSeed + 1013904223;
-                    {
-                        float white = ((noiseSeed >> 9) & 0xFFFF) / 32768.0f;
-                        noiseVal = (white > 0.98f) ? (white * 2.0f - 1.0f) : 0.0f;
-                    }
-                    break;
-                case 15: // Dust (frequent)
-                    noiseSeed = 1664525 * noiseSeed + 1013904223;
-                    {
-                        float white = ((noiseSeed >> 9) & 0xFFFF) / 32768.0f;
-                        noiseVal = (white > 0.90f) ? (white * 2.0f - 1.0f) : 0.0f;
-                    }
-                    break;
-                case 16: // Chopper (slow)
-                    noiseSeed = 1664525 * noiseSeed + 1013904223;
-                    {
-                        float white = ((noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
-                        chopperPhase1 += 0.005f;
-                        if (chopperPhase1 > 2.0f * M_PI) chopperPhase1 -= 2.0f * M_PI;
-                        noiseVal = white * (sinf(chopperPhase1) > 0.0f ? 1.0f : 0.0f);
-                    }
-                    break;
-                case 17: // Chopper (medium)
-                    noiseSeed = 1664525 * noiseSeed + 1013904223;
-                    {
-                        float white = ((noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
-                        chopperPhase2 += 0.02f;
-                        if (chopperPhase2 > 2.0f * M_PI) chopperPhase2 -= 2.0f * M_PI;
-                        noiseVal = white * (sinf(chopperPhase2) > 0.0f ? 1.0f : 0.0f);
-                    }
-                    break;
-                case 18: // Chopper (fast)
-                    noiseSeed = 1664525 * noiseSeed + 1013904223;
-                    {
-                        float white = ((noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
-                        chopperPhase3 += 0.08f;
-                        if (chopperPhase3 > 2.0f * M_PI) chopperPhase3 -= 2.0f * M_PI;
-                        noiseVal = white * (sinf(chopperPhase3) > 0.0f ? 1.0f : 0.0f);
-                    }
-                    break;
-                case 19: // Metallic (xor-shift)
-                    noiseSeed = 1664525 * noiseSeed + 1013904223;
-                    {
-                        uint32_t n = noiseSeed;
-                        n ^= n << 13; n ^= n >> 17; n ^= n << 5;
-                        noiseVal = ((n & 0xFF) / 128.0f) - 1.0f;
-                    }
-                    break;
-                case 20: // AM Noise (slow)
-                    noiseSeed = 1664525 * noiseSeed + 1013904223;
-                    {
-                        float white = ((noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
-                        amPhase1 += 0.01f;
-                        if (amPhase1 > 2.0f * M_PI) amPhase1 -= 2.0f * M_PI;
-                        noiseVal = white * (0.5f + 0.5f * sinf(amPhase1));
-                    }
-                    break;
-                case 21: // AM Noise (fast)
-                    noiseSeed = 1664525 * noiseSeed + 1013904223;
-                    {
-                        float white = ((noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
-                        amPhase2 += 0.05f;
-                        if (amPhase2 > 2.0f * M_PI) amPhase2 -= 2.0f * M_PI;
-                        noiseVal = white * (0.5f + 0.5f * sinf(amPhase2));
-                    }
-                    break;
-                case 22: // Ringmod Noise (slow)
-                {
-                    float white = ((noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
-                    ringPhase1 += 0.01f;
-                    if (ringPhase1 > 2.0f * M_PI) ringPhase1 -= 2.0f * M_PI;
-                    noiseVal = white * sinf(ringPhase1);
-                }
-                break;
-                case 23: // Ringmod Noise (fast)
-                noiseSeed = 1664525 * noiseSeed + 1013904223;
-                {
-                    float white = ((noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
-                    ringPhase2 += 0.05f;
-                    if (ringPhase2 > 2.0f * M_PI) ringPhase2 -= 2.0f * M_PI;
-                    noiseVal = white * sinf(ringPhase2);
-                }
-                break;
-                case 24: // Envelope-followed Noise (slow)
-                noiseSeed = 1664525 * noiseSeed + 1013904223;
-                {
-                    float white = ((noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
-                    envPhase1 += 0.005f;
-                    if (envPhase1 > 2.0f * M_PI) envPhase1 -= 2.0f * M_PI;
-                    noiseVal = white * fabsf(sinf(envPhase1));
-                }
-                break;
-                case 25: // Envelope-followed Noise (fast)
-                noiseSeed = 1664525 * noiseSeed + 1013904223;
-                {
-                    float white = ((noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
-                    envPhase2 += 0.03f;
-                    if (envPhase2 > 2.0f * M_PI) envPhase2 -= 2.0f * M_PI;
-                    noiseVal = white * fabsf(sinf(envPhase2));
-                }
-                break;
-                case 26: // Blue+Pink Mix
-                noiseSeed = 1664525 * noiseSeed + 1013904223;
-                {
-                    float white = ((noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
-                    float blue = white - blueLast;
-                    blueLast = white;
-                    pink = 0.98f * pink + 0.02f * white;
-                    noiseVal = 0.5f * blue + 0.5f * pink;
-                }
-                break;
-                case 27: // HP+LP Mix
-                noiseSeed = 1664525 * noiseSeed + 1013904223;
-                {
-                    float white = ((noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
-                    hp1 = 0.8f * hp1 + white - (0.8f * hp1);
-                    lp1 = 0.85f * lp1 + 0.15f * white;
-                    noiseVal = 0.5f * hp1 + 0.5f * lp1;
-                }
-                break;
-                case 28: // S&H + Bitcrush Mix
-                if (++sAndHcnt1 > 40) {
-                    noiseSeed = 1664525 * noiseSeed + 1013904223;
-                    sAndH1 = ((noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
-                    sAndHcnt1 = 0;
-                }
-                {
-                    float bc = floorf(sAndH1 * 4.0f) / 4.0f;
-                    noiseVal = 0.5f * sAndH1 + 0.5f * bc;
-                }
-                break;
-                case 29: // White + Metallic Mix
-                noiseSeed = 1664525 * noiseSeed + 1013904223;
-                {
-                    float white = ((noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
-                    uint32_t n = noiseSeed;
-                    n ^= n << 13; n ^= n >> 17; n ^= n << 5;
-                    float metallic = ((n & 0xFF) / 128.0f) - 1.0f;
-                    noiseVal = 0.5f * white + 0.5f * metallic;
-                }
-                break;
-                default: // fallback to White Noise
-                    noiseSeed = 1664525 * noiseSeed + 1013904223;
-                    noiseVal = ((noiseSeed >> 9) & 0xFFFF) / 32768.0f - 1.0f;
-                break;
-                noiseSeed = 1664525 * noiseSeed + 1013904223;
-                }
-            // Apply noise envelope                
-            float noiseEnv = computeADSR(self->noiseEnv, noiseA, noiseD, noiseS, noiseR, self->noiseGate);
-            float noise = noiseVal * noiseEnv * noiseLevel;
-            sample += noise;
-                if (silent) self->voices[v].active = false;
-                    sample += sum;
-                    self->voices[v].age += 1.0f / SAMPLE_RATE;
-                }
+// Update gates
+    for (int lane = 0; lane < numLanes; ++lane) {
+        self->lastGate[lane] = gateState[lane];
+        self->lastGateIn[lane] = gateInEnd[lane];
+    }
+    self->sampleTime += numFrames;
 
-            // Output lowpass filter for smoothing
-            float alpha = expf(-2.0f * M_PI * 3000.0f / SAMPLE_RATE);
-            sample = self->lpState + alpha * (sample - self->lpState);
-            self->lpState = sample;
+    governor.update(governor.clockAvailable ? governorTicks() - startTicks : 0, numFrames, d.cpuBudget, self->maxModes, self->numVoices);
+}
 
-        // Write output (attenuated)
-        outL[f] = sample * 0.1f;
-        outR[f] = sample * 0.1f;
-    }
-// Update gates
-    self->lastTrigger1 = gateState1;
-    self->lastTrigger2 = gateState2;
+// Static memory: tables shared by all instances, built once when the plugin is loaded
+void calculateStaticRequirements(_NT_staticRequirements& req) {
+    req.dram = sizeof(CoefTables) + sizeof(ExcitationBank);
+}
+
+void initialise(_NT_staticMemoryPtrs& ptrs, const _NT_staticRequirements& req) {
+    coefTables = new(ptrs.dram) CoefTables;
+    coefTables->build();
+    excitationBank = new(ptrs.dram + sizeof(CoefTables)) ExcitationBank;
+    excitationBank->build();
 }
 
 // Required Disting NT API functions
-extern "C" void parameterChanged(_NT_algorithm*, int) {}
-extern "C" void calculateRequirements(_NT_algorithmRequirements& req, const int32_t*) {
-    req.numParameters = ARRAY_SIZE(parameters);
-    req.sram = sizeof(ModalInstrument);
+extern "C" void parameterChanged(_NT_algorithm* base, int) {
+    updateDerivedParams(static_cast<ModalInstrument*>(base));
+}
+extern "C" void calculateRequirements(_NT_algorithmRequirements& req, const int32_t* specifications) {
+    InstanceLayout layout(specifications);
+    req.numParameters = layout.numParameters;
+    req.sram = layout.sram;
     req.dram = 0;
-    req.dtc = 0;
+    req.dtc = layout.dtc;
     req.itc = 0;
 }
 
+// MIDI: note-on plays the lane of its channel, note-off and polyphonic
+// aftertouch damp it. Queued with the current sample clock, so it plays at
+// the first frame of the next block.
+extern "C" void midiMessage(_NT_algorithm* base, uint8_t byte0, uint8_t byte1, uint8_t byte2) {
+    ModalInstrument* self = static_cast<ModalInstrument*>(base);
+    int channel = self->v[kParamMidiChannel];
+    if (channel == 0) return;
+    int lane = (byte0 & 0x0F) - (channel - 1);
+    if (lane < 0 || lane >= self->numLanes) return;
+    uint8_t kind;
+    switch (byte0 & 0xF0) {
+        case 0x90: kind = byte2 ? kNoteOn : kNoteOff; break;
+        case 0x80: kind = kNoteOff; break;
+        case 0xA0: kind = kNotePressure; break;
+        default: return;
+    }
+    self->queue.push({ self->sampleTime, kind, (uint8_t)lane, (uint8_t)(byte1 & 0x7F), (uint8_t)(byte2 & 0x7F) });
+}
+
 static const _NT_factory factory = {
     .guid = NT_MULTICHAR('H','A','N','D'),
     .name = "HandpanModalXT",
     .description = "Modal Perc Synth",
-    .numSpecifications = 0,
-    .specifications = nullptr,
-    .calculateStaticRequirements = nullptr,
-    .initialise = nullptr,
+    .numSpecifications = ARRAY_SIZE(specifications),
+    .specifications = specifications,
+    .calculateStaticRequirements = calculateStaticRequirements,
+    .initialise = initialise,
     .calculateRequirements = calculateRequirements,
     .construct = construct,
     .parameterChanged = parameterChanged,
     .step = step,
     .draw = nullptr,
     .midiRealtime = nullptr,
-    .midiMessage = nullptr,
+    .midiMessage = midiMessage,
     .tags = kNT_tagInstrument
 };
 
@@ -0,0 +1,138 @@
+// Fast math for the Handpan plugins
+// Author: Fabian Martinez
+//
+// Polynomial approximations of the libm functions used at run time: pitch
+// (1V/oct exp2), decay and lifetime maths (exp, log, pow), saturation (tanh)
+// and the noise LFOs (sin, cos). No tables, no libm calls, no branches other
+// than the range checks, so they are cheap on the Cortex-M7 FPU.
+//
+// Error bounds, measured against libm over the ranges below (bench --accuracy):
+//
+//   fastExp2(x)    relative  < 3.0e-7   x in [-126, 126]
+//   fastExp(x)     relative  < 5.0e-7   x in [-4, 4]   (< 4.0e-6 in [-87, 87])
+//   fastLog2(x)    absolute  < 2.0e-7   x > 0, normal floats (relative once |result| > 1)
+//   fastLog(x)     absolute  < 2.0e-7   x > 0, normal floats (relative once |result| > 1)
+//   fastPow(a, k)  relative  < 2.0e-6   a > 0, |k * log2(a)| < 126
+//   fastTanh(x)    absolute  < 3.0e-7   all x
+//   fastSin(x)     absolute  < 3.0e-7   |x| < 1000
+//   fastCos(x)     absolute  < 3.0e-7   |x| < 1000
+
+#ifndef HANDPAN_FASTMATH_H
+#define HANDPAN_FASTMATH_H
+
+#include <cstdint>
+#include <cstring>
+
+namespace fastmath {
+
+inline float bitsToFloat(uint32_t i) { float f; memcpy(&f, &i, sizeof(f)); return f; }
+inline uint32_t floatToBits(float f) { uint32_t i; memcpy(&i, &f, sizeof(i)); return i; }
+
+// Round to nearest integer (ties away from zero), valid for |x| < 2^23
+inline int roundToInt(float x) { return (int)(x + (x >= 0.0f ? 0.5f : -0.5f)); }
+
+} // namespace fastmath
+
+// 2^x: integer part into the exponent bits, 2^f for f in [-0.5, 0.5] by a
+// degree 6 Taylor polynomial
+inline float fastExp2(float x) {
+    if (x < -126.0f) return 0.0f;
+    if (x > 126.0f) x = 126.0f;
+    int i = fastmath::roundToInt(x);
+    float f = x - (float)i;
+    float p = 1.5403530e-4f;
+    p = p * f + 1.3333558e-3f;
+    p = p * f + 9.6181291e-3f;
+    p = p * f + 5.5504109e-2f;
+    p = p * f + 2.4022651e-1f;
+    p = p * f + 6.9314718e-1f;
+    p = p * f + 1.0f;
+    return p * fastmath::bitsToFloat((uint32_t)(i + 127) << 23);
+}
+
+// e^x
+inline float fastExp(float x) {
+    return fastExp2(x * 1.44269504f);
+}
+
+// log2(x) for x > 0: exponent bits plus 2 atanh(s) for the mantissa, taken
+// in [sqrt(1/2), sqrt(2)) so that |s| < 0.172
+inline float fastLog2(float x) {
+    uint32_t bits = fastmath::floatToBits(x);
+    int e = (int)((bits >> 23) & 0xFF) - 127;
+    float m = fastmath::bitsToFloat((bits & 0x007FFFFFu) | 0x3F800000u);      // [1, 2)
+    if (m > 1.41421356f) { m *= 0.5f; e += 1; }
+    float s = (m - 1.0f) / (m + 1.0f);
+    float s2 = s * s;
+    float p = 0.22222222f;                  // 2/9
+    p = p * s2 + 0.28571429f;               // 2/7
+    p = p * s2 + 0.4f;                      // 2/5
+    p = p * s2 + 0.66666667f;               // 2/3
+    p = p * s2 + 2.0f;
+    return (float)e + p * s * 1.44269504f;
+}
+
+// ln(x) for x > 0
+inline float fastLog(float x) {
+    return fastLog2(x) * 0.69314718f;
+}
+
+// a^k for a > 0
+inline float fastPow(float a, float k) {
+    return fastExp2(k * fastLog2(a));
+}
+
+// tanh(x) = (1 - e^-2|x|) / (1 + e^-2|x|), with the sign put back; odd
+// polynomial near zero where the difference would lose precision
+inline float fastTanh(float x) {
+    float ax = x < 0.0f ? -x : x;
+    float t;
+    if (ax < 0.0625f) {
+        float x2 = ax * ax;
+        t = ax * (1.0f + x2 * (-0.33333333f + x2 * (0.13333333f + x2 * -0.053968254f)));
+    } else if (ax > 9.0f) {
+        t = 1.0f;
+    } else {
+        float e = fastExp2(-2.88539008f * ax);  // e^(-2|x|)
+        t = (1.0f - e) / (1.0f + e);
+    }
+    return x < 0.0f ? -t : t;
+}
+
+namespace fastmath {
+
+// x minus the nearest whole number of turns, in [-pi, pi]: two-part 2pi
+// (Cody-Waite), exact for |x| < 2^16
+inline float reduceTurns(float x) {
+    float k = (float)roundToInt(x * 0.159154943f);
+    return (x - k * 6.28125f) - k * 1.93530718e-3f;
+}
+
+// sin(z) for z in [-pi/2, pi/2], degree 11 odd Taylor polynomial
+inline float sinPoly(float z) {
+    float z2 = z * z;
+    float p = -2.5052108e-8f;
+    p = p * z2 + 2.7557319e-6f;
+    p = p * z2 - 1.9841270e-4f;
+    p = p * z2 + 8.3333333e-3f;
+    p = p * z2 - 1.6666667e-1f;
+    return z + z * z2 * p;
+}
+
+} // namespace fastmath
+
+// sin(x): fold the reduced angle into [-pi/2, pi/2]
+inline float fastSin(float x) {
+    float z = fastmath::reduceTurns(x);
+    if (z > 1.57079633f) z = 3.14159265f - z;
+    else if (z < -1.57079633f) z = -3.14159265f - z;
+    return fastmath::sinPoly(z);
+}
+
+// cos(x) = sin(pi/2 - |z|) for the reduced angle z
+inline float fastCos(float x) {
+    float z = fastmath::reduceTurns(x);
+    return fastmath::sinPoly(1.57079633f - (z < 0.0f ? -z : z));
+}
+
+#endif // HANDPAN_FASTMATH_H